@@ -0,0 +1,82 @@
+# Build modes layered on top of CMAKE_BUILD_TYPE. CMakePresets.json has the
+# usual combinations; tools/bench_modes.sh compares them.
+#
+#   S1AP_LTO=ON             link-time optimization
+#   S1AP_PGO=GENERATE|USE   profile-guided optimization, profiles in S1AP_PGO_DIR
+#   S1AP_MARCH=<arch>       -march value, e.g. native or x86-64-v3
+#   S1AP_SANITIZER=<list>   -fsanitize value, e.g. address,undefined or thread
+
+option(S1AP_LTO "Enable link-time optimization" OFF)
+
+set(S1AP_PGO "" CACHE STRING "Profile-guided optimization stage: GENERATE, USE or empty")
+set_property(CACHE S1AP_PGO PROPERTY STRINGS "" GENERATE USE)
+
+set(S1AP_PGO_DIR "${CMAKE_BINARY_DIR}/pgo" CACHE PATH "Directory holding PGO profiles")
+set(S1AP_PGO_TRAINING_ARGS "--events 1000000 --repeat 1" CACHE STRING "s1ap_bench arguments of the PGO training run")
+
+set(S1AP_MARCH "" CACHE STRING "Target architecture passed to -march")
+set(S1AP_SANITIZER "" CACHE STRING "Sanitizers passed to -fsanitize")
+
+if (S1AP_LTO)
+    include(CheckIPOSupported)
+    check_ipo_supported(RESULT S1AP_LTO_SUPPORTED OUTPUT S1AP_LTO_ERROR)
+
+    if (NOT S1AP_LTO_SUPPORTED)
+        message(FATAL_ERROR "S1AP_LTO: ${S1AP_LTO_ERROR}")
+    endif()
+
+    set(CMAKE_INTERPROCEDURAL_OPTIMIZATION ON)
+endif()
+
+if (S1AP_MARCH)
+    add_compile_options(-march=${S1AP_MARCH})
+endif()
+
+if (S1AP_SANITIZER)
+    add_compile_options(-fsanitize=${S1AP_SANITIZER} -fno-omit-frame-pointer)
+    add_link_options(-fsanitize=${S1AP_SANITIZER})
+endif()
+
+# GCC keys .gcda files by object path, so GENERATE and USE have to share a
+# build directory. Clang needs the raw profiles merged first (pgo_train).
+if (S1AP_PGO STREQUAL "GENERATE")
+    add_compile_options(-fprofile-generate=${S1AP_PGO_DIR})
+    add_link_options(-fprofile-generate=${S1AP_PGO_DIR})
+elseif (S1AP_PGO STREQUAL "USE")
+    if (CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+        add_compile_options(-fprofile-use=${S1AP_PGO_DIR}/default.profdata -Wno-profile-instr-unprofiled)
+    else()
+        add_compile_options(-fprofile-use=${S1AP_PGO_DIR} -fprofile-partial-training -Wno-missing-profile)
+    endif()
+elseif (S1AP_PGO)
+    message(FATAL_ERROR "S1AP_PGO must be GENERATE, USE or empty, got '${S1AP_PGO}'")
+endif()
+
+# Runs the instrumented s1ap_bench and leaves a profile for S1AP_PGO=USE.
+function(s1ap_add_pgo_training)
+    if (NOT S1AP_PGO STREQUAL "GENERATE")
+        return()
+    endif()
+
+    separate_arguments(arguments UNIX_COMMAND "${S1AP_PGO_TRAINING_ARGS}")
+    set(commands
+        COMMAND ${CMAKE_COMMAND} -E rm -rf ${S1AP_PGO_DIR}
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${S1AP_PGO_DIR}
+        COMMAND sh -c "\"$<TARGET_FILE:s1ap_bench>\" \"$@\" > /dev/null" s1ap_bench ${arguments}
+    )
+
+    if (CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+        find_program(S1AP_LLVM_PROFDATA NAMES llvm-profdata REQUIRED)
+        list(APPEND commands
+            COMMAND sh -c "cd \"${S1AP_PGO_DIR}\" && \"${S1AP_LLVM_PROFDATA}\" merge -output=default.profdata *.profraw"
+        )
+    endif()
+
+    add_custom_target(pgo_train
+        ${commands}
+        WORKING_DIRECTORY ${CMAKE_BINARY_DIR}
+        DEPENDS s1ap_bench
+        COMMENT "Training PGO profile with s1ap_bench"
+        VERBATIM
+    )
+endfunction()
@@ -0,0 +1,161 @@
+#ifndef BROADCAST_RING_HPP
+#define BROADCAST_RING_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+// Bounded single-producer / multi-consumer ring.
+//
+// The producer never waits for consumers: records are pushed into the ring and
+// made visible in batches by Publish(). Each consumer owns a Cursor and tails
+// the ring at its own pace; a consumer that falls more than the capacity
+// behind loses the overwritten records and is told how many it missed.
+template <typename T>
+class BroadcastRing final
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(std::is_default_constructible_v<T>);
+
+  public:
+    using Sequence = std::uint64_t;
+
+    class Cursor
+    {
+      public:
+        Sequence GetNext() const { return next_; }
+
+      private:
+        friend class BroadcastRing;
+        explicit Cursor(Sequence next) : next_(next) {}
+
+        Sequence next_;
+    };
+
+    struct PollOut
+    {
+      std::size_t count = 0;
+      Sequence lost = 0;
+    };
+
+    explicit BroadcastRing(std::size_t capacity)
+    {
+      capacity_ = 16;
+      while (capacity_ < capacity)
+        capacity_ <<= 1;
+
+      mask_ = capacity_ - 1;
+      slots_ = std::make_unique<Slot[]>(capacity_);
+    }
+
+    BroadcastRing(const BroadcastRing&) = delete;
+    BroadcastRing& operator=(const BroadcastRing&) = delete;
+
+    // Producer only. Returns the sequence number assigned to the record.
+    Sequence Push(const T& record)
+    {
+      const Sequence sequence = tail_++;
+      Slot& slot = slots_[sequence & mask_];
+
+      std::array<std::uint64_t, WORDS> buffer{};
+      std::memcpy(buffer.data(), &record, sizeof(T));
+
+      slot.version.store(sequence * 2 + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      for (std::size_t i = 0; i < WORDS; ++i)
+        slot.words[i].store(buffer[i], std::memory_order_relaxed);
+
+      slot.version.store(sequence * 2 + 2, std::memory_order_release);
+      return sequence;
+    }
+
+    // Producer only. Makes every record pushed so far visible to consumers.
+    void Publish() { head_.store(tail_, std::memory_order_release); }
+
+    // Producer only. Sequence number the next Push() will get.
+    Sequence GetTail() const { return tail_; }
+
+    // A cursor positioned after the last published record.
+    Cursor Subscribe() const { return Cursor(head_.load(std::memory_order_acquire)); }
+
+    // A cursor positioned at the oldest record still held by the ring.
+    Cursor SubscribeFromOldest() const
+    {
+      const Sequence head = head_.load(std::memory_order_acquire);
+      return Cursor(head > capacity_ ? head - capacity_ : 0);
+    }
+
+    PollOut Poll(Cursor& cursor, std::span<T> out) const
+    {
+      PollOut result{};
+      const Sequence head = head_.load(std::memory_order_acquire);
+
+      while (result.count < out.size() && cursor.next_ < head)
+      {
+        if (head - cursor.next_ > capacity_)
+        {
+          result.lost += head - capacity_ - cursor.next_;
+          cursor.next_ = head - capacity_;
+        }
+
+        if (!Read(cursor.next_, out[result.count]))
+        {
+          ++result.lost;
+          ++cursor.next_;
+          continue;
+        }
+
+        ++result.count;
+        ++cursor.next_;
+      }
+
+      return result;
+    }
+
+    std::size_t GetCapacity() const { return capacity_; }
+
+  private:
+    static constexpr std::size_t WORDS = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    struct Slot
+    {
+      std::atomic<std::uint64_t> version{0};
+      std::array<std::atomic<std::uint64_t>, WORDS> words{};
+    };
+
+    // False when the producer has already reused the slot for a newer record.
+    bool Read(const Sequence sequence, T& record) const
+    {
+      const Slot& slot = slots_[sequence & mask_];
+      const std::uint64_t expected = sequence * 2 + 2;
+      std::array<std::uint64_t, WORDS> buffer;
+
+      if (slot.version.load(std::memory_order_acquire) != expected)
+        return false;
+
+      for (std::size_t i = 0; i < WORDS; ++i)
+        buffer[i] = slot.words[i].load(std::memory_order_relaxed);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.version.load(std::memory_order_relaxed) != expected)
+        return false;
+
+      std::memcpy(&record, buffer.data(), sizeof(T));
+      return true;
+    }
+
+    std::size_t capacity_;
+    std::size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+
+    alignas(64) std::atomic<Sequence> head_{0};
+    alignas(64) Sequence tail_ = 0;
+};
+
+#endif // BROADCAST_RING_HPP
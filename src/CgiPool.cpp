@@ -0,0 +1,85 @@
+#include "CgiPool.hpp"
+
+#include <algorithm>
+
+CgiPool::CgiPool()
+: offsets_{0},
+  slots_(64, EMPTY) {}
+
+std::size_t CgiPool::Hash(std::span<const unsigned char> cgi)
+{
+  std::size_t hash = 14695981039346656037ULL;
+
+  for (const auto byte : cgi)
+  {
+    hash ^= byte;
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+std::size_t CgiPool::FindSlot(std::span<const unsigned char> cgi) const
+{
+  const std::size_t mask = slots_.size() - 1;
+
+  for (std::size_t i = Hash(cgi) & mask;; i = (i + 1) & mask)
+  {
+    if (slots_[i] == EMPTY || std::ranges::equal(GetCgi(slots_[i] - 1), cgi))
+      return i;
+  }
+}
+
+S1ap::CellID CgiPool::Intern(std::span<const unsigned char> cgi)
+{
+  std::size_t slot = FindSlot(cgi);
+
+  if (slots_[slot] != EMPTY)
+    return slots_[slot] - 1;
+
+  const auto cellID = static_cast<S1ap::CellID>(Size());
+
+  bytes_.insert(bytes_.end(), cgi.begin(), cgi.end());
+  offsets_.push_back(static_cast<std::uint32_t>(bytes_.size()));
+
+  if ((Size() + 1) * 2 > slots_.size())
+  {
+    Grow();
+    slot = FindSlot(cgi);
+  }
+
+  slots_[slot] = cellID + 1;
+  return cellID;
+}
+
+S1ap::OCellID CgiPool::Find(std::span<const unsigned char> cgi) const
+{
+  const std::size_t slot = FindSlot(cgi);
+
+  if (slots_[slot] == EMPTY)
+    return std::nullopt;
+
+  return slots_[slot] - 1;
+}
+
+std::span<const unsigned char> CgiPool::GetCgi(S1ap::CellID cellID) const
+{
+  return std::span<const unsigned char>(bytes_).subspan(offsets_[cellID], offsets_[cellID + 1] - offsets_[cellID]);
+}
+
+std::size_t CgiPool::Size() const { return offsets_.size() - 1; }
+
+std::size_t CgiPool::GetMemoryUsage() const
+{
+  return bytes_.capacity() + offsets_.capacity() * sizeof(std::uint32_t) + slots_.capacity() * sizeof(std::uint32_t);
+}
+
+void CgiPool::Grow()
+{
+  std::vector<std::uint32_t> slots(slots_.size() * 2, EMPTY);
+  slots_.swap(slots);
+
+  for (const auto id : slots)
+    if (id != EMPTY)
+      slots_[FindSlot(GetCgi(id - 1))] = id;
+}
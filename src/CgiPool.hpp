@@ -0,0 +1,48 @@
+#ifndef CGI_POOL_HPP
+#define CGI_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace S1ap
+{
+  using Cgi = std::vector<unsigned char>;
+
+  using CellID  = std::uint32_t;
+  using OCellID = std::optional<CellID>;
+}
+
+// Interns cell identifiers: equal CGI bytes always get the same dense CellID,
+// so subscribers store 4 bytes instead of their own heap copy and per-cell
+// data can live in vectors indexed by it.
+//
+// All CGI bytes share one arena; the index is an open addressing table of
+// CellIDs, so interning a known cell allocates nothing.
+class CgiPool final
+{
+  public:
+    CgiPool();
+
+    S1ap::CellID Intern(std::span<const unsigned char> cgi);
+    S1ap::OCellID Find(std::span<const unsigned char> cgi) const;
+    std::span<const unsigned char> GetCgi(S1ap::CellID cellID) const;
+
+    std::size_t Size() const;
+    std::size_t GetMemoryUsage() const;
+
+  private:
+    static constexpr std::uint32_t EMPTY = 0;
+
+    static std::size_t Hash(std::span<const unsigned char> cgi);
+    std::size_t FindSlot(std::span<const unsigned char> cgi) const;
+    void Grow();
+
+    std::vector<unsigned char> bytes_;
+    std::vector<std::uint32_t> offsets_;
+    std::vector<std::uint32_t> slots_;  // CellID + 1, EMPTY for a free slot
+};
+
+#endif // CGI_POOL_HPP
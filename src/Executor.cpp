@@ -0,0 +1,74 @@
+#include "Executor.hpp"
+
+namespace
+{
+  class NoopTask final : public ExecutorTask
+  {
+    public:
+      void Run() override {}
+  };
+}
+
+ThreadExecutor::ThreadExecutor()
+: thread_([this] { Loop(); }) {}
+
+ThreadExecutor::~ThreadExecutor()
+{
+  NoopTask wakeUp;
+
+  stop_.store(true);
+  Post(wakeUp);
+  thread_.join();
+}
+
+void ThreadExecutor::Post(ExecutorTask& task)
+{
+  ExecutorTask* head = head_.load(std::memory_order_relaxed);
+
+  do
+    task.next_ = head;
+  while (!head_.compare_exchange_weak(head, &task));
+
+  if (sleeping_.exchange(false))
+    head_.notify_one();
+}
+
+bool ThreadExecutor::IsCurrent() const
+{
+  return std::this_thread::get_id() == thread_.get_id();
+}
+
+void ThreadExecutor::Loop()
+{
+  for (;;)
+  {
+    ExecutorTask* batch = head_.exchange(nullptr);
+
+    if (batch == nullptr)
+    {
+      if (stop_.load())
+        return;
+
+      sleeping_.store(true);
+      head_.wait(nullptr);
+      sleeping_.store(false);
+      continue;
+    }
+
+    ExecutorTask* ordered = nullptr;
+    while (batch != nullptr)
+    {
+      ExecutorTask* next = batch->next_;
+      batch->next_ = ordered;
+      ordered = batch;
+      batch = next;
+    }
+
+    while (ordered != nullptr)
+    {
+      ExecutorTask* next = ordered->next_;
+      ordered->Run();
+      ordered = next;
+    }
+  }
+}
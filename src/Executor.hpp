@@ -0,0 +1,59 @@
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include <atomic>
+#include <thread>
+
+// Unit of work posted to an Executor. Tasks are intrusive: the executor links
+// them into its queue, so posting never allocates. The task must stay alive
+// until Run() is called.
+class ExecutorTask
+{
+  public:
+    virtual void Run() = 0;
+
+  protected:
+    ~ExecutorTask() = default;
+
+  private:
+    friend class ThreadExecutor;
+    ExecutorTask* next_ = nullptr;
+};
+
+class Executor
+{
+  public:
+    virtual ~Executor() = default;
+
+    // Thread-safe, never blocks.
+    virtual void Post(ExecutorTask& task) = 0;
+
+    // True when called from the thread that runs this executor's tasks.
+    virtual bool IsCurrent() const = 0;
+};
+
+// Executor that owns one thread. Producers push onto a lock-free stack, the
+// thread takes everything queued so far in one exchange and runs it in
+// posting order, so many requests in flight are drained in batches.
+class ThreadExecutor final : public Executor
+{
+  public:
+    ThreadExecutor();
+    ~ThreadExecutor() override;
+
+    ThreadExecutor(const ThreadExecutor&) = delete;
+    ThreadExecutor& operator=(const ThreadExecutor&) = delete;
+
+    void Post(ExecutorTask& task) override;
+    bool IsCurrent() const override;
+
+  private:
+    void Loop();
+
+    std::atomic<ExecutorTask*> head_{nullptr};
+    std::atomic<bool> sleeping_{false};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+#endif // EXECUTOR_HPP
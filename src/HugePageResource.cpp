@@ -0,0 +1,150 @@
+#include "HugePageResource.hpp"
+
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <new>
+
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+  constexpr std::size_t HUGE_2M = std::size_t{1} << 21;
+  constexpr std::size_t HUGE_1G = std::size_t{1} << 30;
+
+  constexpr int MAX_NUMA_NODES = 1024;
+  constexpr std::size_t MASK_BITS = sizeof(unsigned long) * CHAR_BIT;
+
+  int CurrentNode()
+  {
+    unsigned cpu = 0;
+    unsigned node = 0;
+
+    return ::getcpu(&cpu, &node) == 0 ? static_cast<int>(node) : HugePageResource::LOCAL_NODE;
+  }
+
+  // Prefer the node rather than insist on it: running out of memory there
+  // should spill over, not fail the allocation.
+  void BindToNode(void* address, std::size_t size, int node)
+  {
+    if (node < 0 || node >= MAX_NUMA_NODES)
+      return;
+
+    std::array<unsigned long, MAX_NUMA_NODES / MASK_BITS> mask{};
+    mask[node / MASK_BITS] = 1UL << (node % MASK_BITS);
+
+    ::syscall(SYS_mbind, address, size, MPOL_PREFERRED, mask.data(), MAX_NUMA_NODES + 1, 0);
+  }
+}
+
+HugePageResource::HugePageResource(const Config& config)
+: config_(config),
+  pageSize_(config.pageSize == PageSize::Huge1G ? HUGE_1G : HUGE_2M) {}
+
+HugePageResource::~HugePageResource()
+{
+  for (const auto& arena : arenas_)
+    Unmap(arena.address, arena.size);
+}
+
+HugePageResource::Stats HugePageResource::GetStats() const
+{
+  std::lock_guard lock(mutex_);
+  return stats_;
+}
+
+void* HugePageResource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+  std::lock_guard lock(mutex_);
+
+  if (bytes >= pageSize_ / 2)
+    return Map(RoundUp(bytes));
+
+  auto cursor = reinterpret_cast<std::uintptr_t>(arenaCursor_);
+  cursor = (cursor + alignment - 1) & ~(alignment - 1);
+
+  if (arenaCursor_ == nullptr || cursor + bytes > reinterpret_cast<std::uintptr_t>(arenaEnd_))
+  {
+    auto* arena = static_cast<std::byte*>(Map(pageSize_));
+    arenas_.push_back(Mapping{arena, pageSize_});
+
+    arenaEnd_ = arena + pageSize_;
+    cursor = reinterpret_cast<std::uintptr_t>(arena);
+  }
+
+  arenaCursor_ = reinterpret_cast<std::byte*>(cursor + bytes);
+  return reinterpret_cast<void*>(cursor);
+}
+
+void HugePageResource::do_deallocate(void* p, std::size_t bytes, std::size_t)
+{
+  // Arena pieces live until the resource goes away.
+  if (bytes < pageSize_ / 2)
+    return;
+
+  std::lock_guard lock(mutex_);
+  Unmap(p, RoundUp(bytes));
+}
+
+bool HugePageResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+  return this == &other;
+}
+
+std::size_t HugePageResource::RoundUp(std::size_t bytes) const
+{
+  return (bytes + pageSize_ - 1) & ~(pageSize_ - 1);
+}
+
+void* HugePageResource::Map(std::size_t size)
+{
+  constexpr int PROTECTION = PROT_READ | PROT_WRITE;
+  constexpr int FLAGS = MAP_PRIVATE | MAP_ANONYMOUS;
+
+  void* address = MAP_FAILED;
+
+  if (config_.pageSize != PageSize::Transparent)
+  {
+    const int pageShift = config_.pageSize == PageSize::Huge1G ? 30 : 21;
+    address = ::mmap(nullptr, size, PROTECTION, FLAGS | MAP_HUGETLB | (pageShift << MAP_HUGE_SHIFT), -1, 0);
+  }
+
+  const bool hugeTlb = address != MAP_FAILED;
+
+  if (!hugeTlb)
+  {
+    // No reserved huge pages: map with room to align on a 2MB boundary so
+    // khugepaged can back the whole range, then trim the excess.
+    auto* raw = static_cast<std::byte*>(::mmap(nullptr, size + HUGE_2M, PROTECTION, FLAGS, -1, 0));
+    if (raw == MAP_FAILED)
+      throw std::bad_alloc();
+
+    auto* aligned = reinterpret_cast<std::byte*>((reinterpret_cast<std::uintptr_t>(raw) + HUGE_2M - 1) & ~(HUGE_2M - 1));
+
+    if (aligned != raw)
+      ::munmap(raw, aligned - raw);
+    if (aligned + size != raw + size + HUGE_2M)
+      ::munmap(aligned + size, raw + size + HUGE_2M - (aligned + size));
+
+    ::madvise(aligned, size, MADV_HUGEPAGE);
+    address = aligned;
+  }
+
+  const int node = config_.numaNode == LOCAL_NODE ? CurrentNode() : config_.numaNode;
+  BindToNode(address, size, node);
+
+  (hugeTlb ? stats_.hugeTlbBytes : stats_.transparentBytes) += size;
+  ++stats_.mappings;
+  stats_.numaNode = node;
+
+  return address;
+}
+
+void HugePageResource::Unmap(void* address, std::size_t size)
+{
+  ::munmap(address, size);
+}
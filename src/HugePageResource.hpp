@@ -0,0 +1,77 @@
+#ifndef HUGE_PAGE_RESOURCE_HPP
+#define HUGE_PAGE_RESOURCE_HPP
+
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+// Memory resource backed by huge pages, bound to one NUMA node.
+//
+// Allocations of half a page or more get their own mapping; smaller ones are
+// carved out of shared arena pages and only returned when the resource is
+// destroyed, which suits node-based containers sitting on a pool resource.
+// Each mapping tries explicit hugetlbfs pages of the configured size first,
+// then transparent huge pages, then plain pages, and is bound to the NUMA
+// node of the thread that allocates it unless a node is given.
+class HugePageResource final : public std::pmr::memory_resource
+{
+  public:
+    enum class PageSize
+    {
+      Transparent,   // madvise(MADV_HUGEPAGE) only
+      Huge2M,
+      Huge1G,
+    };
+
+    static constexpr int LOCAL_NODE = -1;
+
+    struct Config
+    {
+      PageSize pageSize = PageSize::Huge2M;
+      int numaNode = LOCAL_NODE;
+    };
+
+    // Cumulative over the lifetime of the resource.
+    struct Stats
+    {
+      std::size_t hugeTlbBytes = 0;      // explicit huge pages
+      std::size_t transparentBytes = 0;  // fell back to THP
+      std::size_t mappings = 0;
+      int numaNode = LOCAL_NODE;         // node of the last mapping, if known
+    };
+
+    explicit HugePageResource(const Config& config);
+    ~HugePageResource() override;
+
+    HugePageResource(const HugePageResource&) = delete;
+    HugePageResource& operator=(const HugePageResource&) = delete;
+
+    Stats GetStats() const;
+
+  private:
+    struct Mapping
+    {
+      void* address;
+      std::size_t size;
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    void* Map(std::size_t size);
+    void Unmap(void* address, std::size_t size);
+    std::size_t RoundUp(std::size_t bytes) const;
+
+    Config config_;
+    std::size_t pageSize_;
+
+    mutable std::mutex mutex_;
+    std::vector<Mapping> arenas_;
+    std::byte* arenaCursor_ = nullptr;
+    std::byte* arenaEnd_ = nullptr;
+    Stats stats_{};
+};
+
+#endif // HUGE_PAGE_RESOURCE_HPP
@@ -0,0 +1,53 @@
+#include "S1apAsync.hpp"
+
+#include <utility>
+
+S1apAsync::S1apAsync(S1apDB& db, Executor& owner)
+: db_(db),
+  owner_(owner) {}
+
+S1apAsync::HandleAwaitable S1apAsync::HandleAsync(Event event)
+{
+  return HandleAwaitable(db_, owner_, nullptr, std::move(event));
+}
+
+S1apAsync::HandleAwaitable S1apAsync::HandleAsync(Event event, Executor& resumeOn)
+{
+  return HandleAwaitable(db_, owner_, &resumeOn, std::move(event));
+}
+
+S1apAsync::HandleAwaitable::HandleAwaitable(S1apDB& db, Executor& owner, Executor* resumeOn, Event event)
+: db_(db),
+  owner_(owner),
+  resumeOn_(resumeOn),
+  event_(std::move(event)) {}
+
+bool S1apAsync::HandleAwaitable::await_ready()
+{
+  // Already on the owner thread and staying there: no reason to suspend.
+  if (owner_.IsCurrent() && (resumeOn_ == nullptr || resumeOn_ == &owner_))
+    result_.emplace(db_.Handle(event_));
+
+  return result_.has_value();
+}
+
+void S1apAsync::HandleAwaitable::await_suspend(std::coroutine_handle<> caller)
+{
+  resume_.caller = caller;
+  owner_.Post(*this);
+}
+
+S1apDB::HandleOut S1apAsync::HandleAwaitable::await_resume()
+{
+  return std::move(result_).value();
+}
+
+void S1apAsync::HandleAwaitable::Run()
+{
+  result_.emplace(db_.Handle(event_));
+
+  if (resumeOn_ != nullptr)
+    resumeOn_->Post(resume_);
+  else
+    resume_.caller.resume();
+}
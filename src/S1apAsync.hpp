@@ -0,0 +1,61 @@
+#ifndef S1AP_ASYNC_HPP
+#define S1AP_ASYNC_HPP
+
+#include "Executor.hpp"
+#include "S1apDB.hpp"
+
+#include <coroutine>
+#include <optional>
+
+// Awaitable front-end for an S1apDB owned by a single executor thread.
+//
+// co_await HandleAsync(event) suspends the caller, runs Handle() on the owner
+// executor and resumes the caller with the result: on the given executor, or
+// directly on the owner thread when none is given. The awaitable lives in the
+// caller's coroutine frame and is the queue node itself, so thousands of
+// requests can be in flight without allocating.
+class S1apAsync final
+{
+  public:
+    class HandleAwaitable final : private ExecutorTask
+    {
+      public:
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> caller);
+        S1apDB::HandleOut await_resume();
+
+      private:
+        friend class S1apAsync;
+
+        HandleAwaitable(S1apDB& db, Executor& owner, Executor* resumeOn, Event event);
+
+        void Run() override;
+
+        class ResumeTask final : public ExecutorTask
+        {
+          public:
+            void Run() override { caller.resume(); }
+
+            std::coroutine_handle<> caller;
+        };
+
+        S1apDB& db_;
+        Executor& owner_;
+        Executor* resumeOn_;
+        Event event_;
+
+        ResumeTask resume_;
+        std::optional<S1apDB::HandleOut> result_;
+    };
+
+    S1apAsync(S1apDB& db, Executor& owner);
+
+    HandleAwaitable HandleAsync(Event event);
+    HandleAwaitable HandleAsync(Event event, Executor& resumeOn);
+
+  private:
+    S1apDB& db_;
+    Executor& owner_;
+};
+
+#endif // S1AP_ASYNC_HPP
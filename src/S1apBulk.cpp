@@ -0,0 +1,387 @@
+#include "S1apDB.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <thread>
+
+// Bulk layout, little-endian, one column after another:
+//
+//   u32 magic | u16 version | u16 reserved | u64 count | u32 cellCount | u32 cellBytes
+//   u64 enodebCount
+//   u64 imsi[count]
+//   u32 mTmsi[count] | u32 enodebID[count] | u32 mmeID[count] | u32 cell[count]
+//   u32 cellOffset[cellCount + 1]
+//   u8 state[count] | u8 presence[count]
+//   u8 cgi[cellBytes]
+//   u32 enodebKey[enodebCount] | u64 enodebImsi[enodebCount]
+//
+// cell[] indexes a CGI dictionary: cell i is cgi[cellOffset[i], cellOffset[i + 1]).
+// Absent fields are zero and have their presence bit cleared.
+//
+// After a re-attach two subscribers may share an eNodeB ID, so the eNodeB
+// index is carried as it is, like in a snapshot, rather than rebuilt from
+// enodebID[] in whatever order the rows come.
+
+namespace
+{
+  constexpr std::uint32_t BULK_MAGIC = 0x4b423153; // "S1BK"
+  constexpr std::uint16_t BULK_VERSION = 2;
+  constexpr std::size_t BULK_HEADER_SIZE = 32;
+
+  enum BulkPresence : std::uint8_t
+  {
+    HAS_MTMSI    = 1 << 0,
+    HAS_ENODEBID = 1 << 1,
+    HAS_MMEID    = 1 << 2,
+    HAS_CELL     = 1 << 3,
+  };
+
+  constexpr std::uint8_t ALL_PRESENCE = HAS_MTMSI | HAS_ENODEBID | HAS_MMEID | HAS_CELL;
+
+  template <typename T>
+  T Load(const std::byte* p)
+  {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+
+    if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1)
+      value = std::byteswap(value);
+
+    return value;
+  }
+
+  template <typename T>
+  void Store(std::byte* p, T value)
+  {
+    if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1)
+      value = std::byteswap(value);
+
+    std::memcpy(p, &value, sizeof(T));
+  }
+
+  template <typename T>
+  void AppendColumn(std::vector<std::byte>& out, const std::vector<T>& column)
+  {
+    if constexpr (std::endian::native == std::endian::little || sizeof(T) == 1)
+    {
+      const auto* data = reinterpret_cast<const std::byte*>(column.data());
+      out.insert(out.end(), data, data + column.size() * sizeof(T));
+    }
+    else
+    {
+      const auto offset = out.size();
+      out.resize(offset + column.size() * sizeof(T));
+
+      for (std::size_t i = 0; i < column.size(); ++i)
+        Store<T>(out.data() + offset + i * sizeof(T), column[i]);
+    }
+  }
+
+  // Unaligned, read-only view of one column inside the input buffer.
+  template <typename T>
+  class Column
+  {
+    public:
+      Column() = default;
+      Column(const std::byte* data, std::size_t size) : data_(data), size_(size) {}
+
+      T operator[](std::size_t i) const
+      {
+        return Load<T>(data_ + i * sizeof(T));
+      }
+
+      std::size_t Bytes() const { return size_ * sizeof(T); }
+
+    private:
+      const std::byte* data_ = nullptr;
+      std::size_t size_ = 0;
+  };
+}
+
+std::vector<std::byte> S1apDB::ExportSubscribers() const
+{
+  const std::size_t count = imsiToSubscriber.size();
+
+  std::vector<std::uint64_t> imsis;
+  std::vector<std::uint32_t> mTmsis, enodebIDs, mmeIDs, cells;
+  std::vector<std::uint8_t> states, presences;
+
+  for (auto* column : {&mTmsis, &enodebIDs, &mmeIDs, &cells})
+    column->reserve(count);
+  imsis.reserve(count);
+  states.reserve(count);
+  presences.reserve(count);
+
+  for (const auto& [imsi, subscriber] : imsiToSubscriber)
+  {
+    std::uint8_t presence = 0;
+
+    if (subscriber.GetMTmsi().has_value())
+      presence |= HAS_MTMSI;
+    if (subscriber.GetEnodebID().has_value())
+      presence |= HAS_ENODEBID;
+    if (subscriber.GetMmeID().has_value())
+      presence |= HAS_MMEID;
+    if (subscriber.GetCellID().has_value())
+      presence |= HAS_CELL;
+
+    imsis.push_back(imsi);
+    mTmsis.push_back(subscriber.GetMTmsi().value_or(0));
+    enodebIDs.push_back(subscriber.GetEnodebID().value_or(0));
+    mmeIDs.push_back(subscriber.GetMmeID().value_or(0));
+    cells.push_back(subscriber.GetCellID().value_or(0));
+    states.push_back(static_cast<std::uint8_t>(subscriber.GetState()));
+    presences.push_back(presence);
+  }
+
+  // The dictionary is the whole CGI pool, so cell[] is just the CellID.
+  std::vector<std::uint32_t> cellOffsets{0};
+  std::vector<std::uint8_t> cgis;
+
+  for (S1ap::CellID cellID = 0; cellID < cgiPool_.Size(); ++cellID)
+  {
+    const auto cgi = cgiPool_.GetCgi(cellID);
+    cgis.insert(cgis.end(), cgi.begin(), cgi.end());
+    cellOffsets.push_back(static_cast<std::uint32_t>(cgis.size()));
+  }
+
+  std::vector<std::uint32_t> enodebKeys;
+  std::vector<std::uint64_t> enodebImsis;
+
+  enodebKeys.reserve(enodebIDToImsi.size());
+  enodebImsis.reserve(enodebIDToImsi.size());
+
+  for (const auto& [enodebID, imsi] : enodebIDToImsi)
+  {
+    enodebKeys.push_back(enodebID);
+    enodebImsis.push_back(imsi);
+  }
+
+  std::vector<std::byte> out(BULK_HEADER_SIZE);
+  const auto cellCount = static_cast<std::uint32_t>(cgiPool_.Size());
+  const auto cellBytes = static_cast<std::uint32_t>(cgis.size());
+  const std::uint64_t count64 = count;
+  const std::uint64_t enodebCount = enodebKeys.size();
+
+  Store<std::uint32_t>(out.data(), BULK_MAGIC);
+  Store<std::uint16_t>(out.data() + 4, BULK_VERSION);
+  Store<std::uint64_t>(out.data() + 8, count64);
+  Store<std::uint32_t>(out.data() + 16, cellCount);
+  Store<std::uint32_t>(out.data() + 20, cellBytes);
+  Store<std::uint64_t>(out.data() + 24, enodebCount);
+
+  out.reserve(BULK_HEADER_SIZE + count * 26 + cellOffsets.size() * 4 + cgis.size() + enodebCount * 12);
+
+  AppendColumn(out, imsis);
+  AppendColumn(out, mTmsis);
+  AppendColumn(out, enodebIDs);
+  AppendColumn(out, mmeIDs);
+  AppendColumn(out, cells);
+  AppendColumn(out, cellOffsets);
+  AppendColumn(out, states);
+  AppendColumn(out, presences);
+  AppendColumn(out, cgis);
+  AppendColumn(out, enodebKeys);
+  AppendColumn(out, enodebImsis);
+
+  return out;
+}
+
+std::expected<std::size_t, S1apDB::Error> S1apDB::ImportSubscribers(std::span<const std::byte> bulk)
+{
+  if (bulk.size() < BULK_HEADER_SIZE)
+    return std::unexpected(Error::BadImport);
+
+  const auto magic = Load<std::uint32_t>(bulk.data());
+  const auto version = Load<std::uint16_t>(bulk.data() + 4);
+  const auto count = Load<std::uint64_t>(bulk.data() + 8);
+  const auto cellCount = Load<std::uint32_t>(bulk.data() + 16);
+  const auto cellBytes = Load<std::uint32_t>(bulk.data() + 20);
+  const auto enodebCount = Load<std::uint64_t>(bulk.data() + 24);
+
+  if (magic != BULK_MAGIC || version != BULK_VERSION)
+    return std::unexpected(Error::BadImport);
+
+  constexpr std::size_t BYTES_PER_SUBSCRIBER = 8 + 4 * 4 + 2;
+  constexpr std::size_t BYTES_PER_ENODEB = 4 + 8;
+  const std::size_t remaining = bulk.size() - BULK_HEADER_SIZE;
+
+  if (count > remaining / BYTES_PER_SUBSCRIBER
+  ||  enodebCount > remaining / BYTES_PER_ENODEB
+  ||  remaining != count * BYTES_PER_SUBSCRIBER + (std::size_t{cellCount} + 1) * 4 + cellBytes
+                 + enodebCount * BYTES_PER_ENODEB)
+    return std::unexpected(Error::BadImport);
+
+  const std::byte* cursor = bulk.data() + BULK_HEADER_SIZE;
+  auto take = [&cursor]<typename T>(std::size_t size, Column<T>& column) {
+    column = Column<T>(cursor, size);
+    cursor += column.Bytes();
+  };
+
+  Column<std::uint64_t> imsis, enodebImsis;
+  Column<std::uint32_t> mTmsis, enodebIDs, mmeIDs, cells, cellOffsets, enodebKeys;
+  Column<std::uint8_t> states, presences, cgis;
+
+  take(count, imsis);
+  take(count, mTmsis);
+  take(count, enodebIDs);
+  take(count, mmeIDs);
+  take(count, cells);
+  take(std::size_t{cellCount} + 1, cellOffsets);
+  take(count, states);
+  take(count, presences);
+  take(cellBytes, cgis);
+  take(enodebCount, enodebKeys);
+  take(enodebCount, enodebImsis);
+
+  // Validate everything before touching the current state.
+  for (std::uint32_t i = 0; i < cellCount; ++i)
+    if (cellOffsets[i] > cellOffsets[i + 1] || cellOffsets[i + 1] - cellOffsets[i] > Event::MAX_CGI_SIZE)
+      return std::unexpected(Error::BadImport);
+
+  if (cellOffsets[0] != 0 || cellOffsets[cellCount] != cellBytes)
+    return std::unexpected(Error::BadImport);
+
+  S1ap::MTmsi nextMTmsi = 1000;
+  std::vector<std::uint64_t> keys;
+  const S1ap::MTmsi counterMask = shardBits_ == 0 ? ~S1ap::MTmsi{0} : (S1ap::MTmsi{1} << (32 - shardBits_)) - 1;
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const auto presence = presences[i];
+
+    if ((presence & ~ALL_PRESENCE) != 0
+    ||  states[i] > static_cast<std::uint8_t>(SubscriberState::RELEASING)
+    ||  ((presence & HAS_CELL) && cells[i] >= cellCount))
+      return std::unexpected(Error::BadImport);
+
+    if (presence & HAS_MTMSI)
+    {
+      if (!IsOwnMTmsi(mTmsis[i]))
+        return std::unexpected(Error::WrongShard);
+
+      nextMTmsi = std::max(nextMTmsi, (mTmsis[i] & counterMask) + 1);
+    }
+  }
+
+  // A repeated IMSI or M-TMSI would leave the indexes pointing at records
+  // that lost, so the whole import is rejected. So would an eNodeB entry
+  // repeated or pointing at no imported subscriber.
+  auto hasDuplicates = [](std::vector<std::uint64_t>& keys) {
+    std::sort(keys.begin(), keys.end());
+    return std::adjacent_find(keys.begin(), keys.end()) != keys.end();
+  };
+
+  std::vector<std::uint64_t> imsiKeys;
+  imsiKeys.reserve(count);
+  for (std::size_t i = 0; i < count; ++i)
+    imsiKeys.push_back(imsis[i]);
+
+  if (hasDuplicates(imsiKeys))
+    return std::unexpected(Error::BadImport);
+
+  keys.reserve(count);
+  for (std::size_t i = 0; i < count; ++i)
+    if (presences[i] & HAS_MTMSI)
+      keys.push_back(mTmsis[i]);
+
+  if (hasDuplicates(keys))
+    return std::unexpected(Error::BadImport);
+
+  keys.clear();
+  for (std::size_t i = 0; i < enodebCount; ++i)
+  {
+    if (!std::binary_search(imsiKeys.begin(), imsiKeys.end(), enodebImsis[i]))
+      return std::unexpected(Error::BadImport);
+
+    keys.push_back(enodebKeys[i]);
+  }
+
+  if (hasDuplicates(keys))
+    return std::unexpected(Error::BadImport);
+
+  Clear();
+  nextMTmsi_ = nextMTmsi;
+
+  std::vector<S1ap::CellID> cellIDs(cellCount);
+  std::vector<unsigned char> cgi;
+
+  for (std::uint32_t i = 0; i < cellCount; ++i)
+  {
+    cgi.resize(cellOffsets[i + 1] - cellOffsets[i]);
+    for (std::size_t b = 0; b < cgi.size(); ++b)
+      cgi[b] = cgis[cellOffsets[i] + b];
+
+    cellIDs[i] = cgiPool_.Intern(cgi);
+  }
+
+  // Each structure has a single writer, so they are filled side by side.
+  // Counters live with the subscriber records, which own their StatsKey.
+  {
+    std::jthread subscribers([&] {
+      imsiToSubscriber.reserve(count);
+
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        const auto presence = presences[i];
+        Subscriber subscriber;
+
+        subscriber.SetImsi(imsis[i]);
+        subscriber.SetState(static_cast<SubscriberState>(states[i]));
+        subscriber.SetLastEvent(Event::Type::AttachRequest, 0);
+
+        if (presence & HAS_MTMSI)
+          subscriber.SetMTmsi(mTmsis[i]);
+        if (presence & HAS_ENODEBID)
+          subscriber.SetEnodebID(enodebIDs[i]);
+        if (presence & HAS_MMEID)
+          subscriber.SetMmeID(mmeIDs[i]);
+        if (presence & HAS_CELL)
+          subscriber.SetCellID(cellIDs[cells[i]]);
+
+        auto& stored = imsiToSubscriber.emplace(imsis[i], std::move(subscriber)).first->second;
+        StartTrace(stored);
+        UpdateSubscriberStats(stored);
+      }
+    });
+
+    std::jthread mTmsiIndex([&] {
+      mTmsiToImsi.reserve(count);
+      publishedMTmsiToImsi_.Reserve(count);
+
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        if (!(presences[i] & HAS_MTMSI))
+          continue;
+
+        mTmsiToImsi[mTmsis[i]] = imsis[i];
+        publishedMTmsiToImsi_.Store(mTmsis[i], imsis[i]);
+      }
+    });
+
+    std::jthread enodebIndex([&] {
+      enodebIDToImsi.reserve(enodebCount);
+
+      for (std::size_t i = 0; i < enodebCount; ++i)
+        enodebIDToImsi[enodebKeys[i]] = enodebImsis[i];
+    });
+
+    publishedSubscribers_.Reserve(count);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      const auto presence = presences[i];
+      const auto published = MakePublishedSubscriber(
+          imsis[i], static_cast<SubscriberState>(states[i]),
+          presence & HAS_MTMSI ? S1ap::OMTmsi(mTmsis[i]) : std::nullopt,
+          presence & HAS_ENODEBID ? S1ap::OEnodebID(enodebIDs[i]) : std::nullopt,
+          presence & HAS_MMEID ? S1ap::OMmeID(mmeIDs[i]) : std::nullopt,
+          presence & HAS_CELL ? S1ap::OCellID(cellIDs[cells[i]]) : std::nullopt);
+
+      publishedSubscribers_.Store(published.imsi, published);
+    }
+  }
+
+  return count;
+}
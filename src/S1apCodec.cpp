@@ -0,0 +1,453 @@
+#include "S1apCodec.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  template <typename T>
+  T Load(const std::byte* p)
+  {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+
+    if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1)
+      value = std::byteswap(value);
+
+    return value;
+  }
+
+  template <typename T>
+  void Store(std::byte* p, T value)
+  {
+    if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1)
+      value = std::byteswap(value);
+
+    std::memcpy(p, &value, sizeof(T));
+  }
+
+  constexpr std::size_t AlignUp(std::size_t offset)
+  {
+    return (offset + 7) & ~std::size_t{7};
+  }
+
+  constexpr std::size_t EVENT_TYPE_COUNT = 8;
+
+  using P = S1apCodec::Presence;
+
+  // The two presence masks accepted for each Event::Type, mirroring the
+  // Event::Verify* rules. Only AttachRequest has a real alternative.
+  constexpr std::array<std::uint8_t, EVENT_TYPE_COUNT> VALID_PRESENCE_A
+  {
+    P::HAS_IMSI  | P::HAS_ENODEBID | P::HAS_CGI,                 // AttachRequest
+    P::HAS_IMSI  | P::HAS_ENODEBID | P::HAS_MMEID | P::HAS_CGI,  // IdentityResponse
+    P::HAS_MTMSI | P::HAS_ENODEBID | P::HAS_MMEID,               // AttachAccept
+    P::HAS_MTMSI | P::HAS_CGI,                                   // Paging
+    P::HAS_ENODEBID | P::HAS_MMEID | P::HAS_CGI,                 // PathSwitchRequest
+    P::HAS_ENODEBID | P::HAS_MMEID,                              // PathSwitchRequestAcknowledge
+    P::HAS_ENODEBID | P::HAS_MMEID | P::HAS_CGI,                 // UEContextReleaseCommand
+    P::HAS_ENODEBID | P::HAS_MMEID,                              // UEContextReleaseResponse
+  };
+
+  constexpr std::array<std::uint8_t, EVENT_TYPE_COUNT> VALID_PRESENCE_B
+  {
+    P::HAS_MTMSI | P::HAS_ENODEBID | P::HAS_CGI,
+    VALID_PRESENCE_A[1],
+    VALID_PRESENCE_A[2],
+    VALID_PRESENCE_A[3],
+    VALID_PRESENCE_A[4],
+    VALID_PRESENCE_A[5],
+    VALID_PRESENCE_A[6],
+    VALID_PRESENCE_A[7],
+  };
+
+  bool IsValidEventRecord(std::uint8_t type, std::uint8_t presence, std::uint8_t cgiSize)
+  {
+    if (type >= EVENT_TYPE_COUNT || cgiSize > S1apCodec::MAX_CGI_SIZE)
+      return false;
+
+    // Event::Verify() rejects a present but empty CGI of any type.
+    if ((presence & P::HAS_CGI) && cgiSize == 0)
+      return false;
+
+    return presence == VALID_PRESENCE_A[type] || presence == VALID_PRESENCE_B[type];
+  }
+
+  void WriteHeader(std::byte* p, S1apCodec::FrameKind kind, std::uint32_t count, std::uint32_t size)
+  {
+    Store<std::uint32_t>(p, S1apCodec::MAGIC);
+    Store<std::uint16_t>(p + 4, S1apCodec::VERSION);
+    Store<std::uint8_t>(p + 6, static_cast<std::uint8_t>(kind));
+    Store<std::uint8_t>(p + 7, 0);
+    Store<std::uint32_t>(p + 8, count);
+    Store<std::uint32_t>(p + 12, size);
+  }
+
+  void WriteCgi(std::byte* p, const S1ap::OCgi& cgi)
+  {
+    if (cgi.has_value())
+      std::memcpy(p, cgi->data(), cgi->size());
+  }
+
+  S1ap::Cgi ReadCgi(const std::byte* p, std::uint8_t size)
+  {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(p);
+    return S1ap::Cgi(bytes, bytes + size);
+  }
+}
+
+S1apCodec::EventLayout::EventLayout(std::size_t count)
+{
+  type      = HEADER_SIZE;
+  presence  = AlignUp(type + count);
+  cgiSize   = AlignUp(presence + count);
+  timestamp = AlignUp(cgiSize + count);
+  imsi      = timestamp + count * sizeof(std::uint64_t);
+  mTmsi     = imsi + count * sizeof(std::uint64_t);
+  enodebID  = AlignUp(mTmsi + count * sizeof(std::uint32_t));
+  mmeID     = AlignUp(enodebID + count * sizeof(std::uint32_t));
+  cgi       = AlignUp(mmeID + count * sizeof(std::uint32_t));
+  size      = cgi + count * MAX_CGI_SIZE;
+}
+
+S1apCodec::OutLayout::OutLayout(std::size_t count)
+{
+  type     = HEADER_SIZE;
+  presence = AlignUp(type + count);
+  cgiSize  = AlignUp(presence + count);
+  imsi     = AlignUp(cgiSize + count);
+  cgi      = imsi + count * sizeof(std::uint64_t);
+  size     = cgi + count * MAX_CGI_SIZE;
+}
+
+S1apCodec::EncodeOut S1apCodec::Encode(std::span<const Event> events, std::vector<std::byte>& out)
+{
+  const EventLayout layout(events.size());
+
+  if (layout.size > std::numeric_limits<std::uint32_t>::max())
+    return std::unexpected(Error::TooManyRecords);
+
+  const std::size_t begin = out.size();
+  out.resize(begin + layout.size);
+  std::byte* frame = out.data() + begin;
+
+  WriteHeader(frame, FrameKind::Events, static_cast<std::uint32_t>(events.size()), static_cast<std::uint32_t>(layout.size));
+
+  for (std::size_t i = 0; i < events.size(); ++i)
+  {
+    const Event& event = events[i];
+    std::uint8_t presence = 0;
+
+    if (event.GetCgi().has_value() && event.GetCgi()->size() > MAX_CGI_SIZE)
+    {
+      out.resize(begin);
+      return std::unexpected(Error::CgiTooLong);
+    }
+
+    if (event.GetImsi().has_value())
+    {
+      presence |= HAS_IMSI;
+      Store<std::uint64_t>(frame + layout.imsi + i * 8, event.GetImsi().value());
+    }
+
+    if (event.GetMTmsi().has_value())
+    {
+      presence |= HAS_MTMSI;
+      Store<std::uint32_t>(frame + layout.mTmsi + i * 4, event.GetMTmsi().value());
+    }
+
+    if (event.GetEnodebID().has_value())
+    {
+      presence |= HAS_ENODEBID;
+      Store<std::uint32_t>(frame + layout.enodebID + i * 4, event.GetEnodebID().value());
+    }
+
+    if (event.GetMmeID().has_value())
+    {
+      presence |= HAS_MMEID;
+      Store<std::uint32_t>(frame + layout.mmeID + i * 4, event.GetMmeID().value());
+    }
+
+    if (event.GetCgi().has_value())
+    {
+      presence |= HAS_CGI;
+      Store<std::uint8_t>(frame + layout.cgiSize + i, static_cast<std::uint8_t>(event.GetCgi()->size()));
+      WriteCgi(frame + layout.cgi + i * MAX_CGI_SIZE, event.GetCgi());
+    }
+
+    Store<std::uint8_t>(frame + layout.type + i, static_cast<std::uint8_t>(event.GetType()));
+    Store<std::uint8_t>(frame + layout.presence + i, presence);
+    Store<std::uint64_t>(frame + layout.timestamp + i * 8, event.GetTimestamp());
+  }
+
+  return {};
+}
+
+S1apCodec::EncodeOut S1apCodec::Encode(std::span<const S1apOut> outs, std::vector<std::byte>& out)
+{
+  const OutLayout layout(outs.size());
+
+  if (layout.size > std::numeric_limits<std::uint32_t>::max())
+    return std::unexpected(Error::TooManyRecords);
+
+  const std::size_t begin = out.size();
+  out.resize(begin + layout.size);
+  std::byte* frame = out.data() + begin;
+
+  WriteHeader(frame, FrameKind::Outs, static_cast<std::uint32_t>(outs.size()), static_cast<std::uint32_t>(layout.size));
+
+  for (std::size_t i = 0; i < outs.size(); ++i)
+  {
+    const S1apOut& s1apOut = outs[i];
+    std::uint8_t presence = 0;
+
+    if (s1apOut.GetCgi().has_value())
+    {
+      if (s1apOut.GetCgi()->size() > MAX_CGI_SIZE)
+      {
+        out.resize(begin);
+        return std::unexpected(Error::CgiTooLong);
+      }
+
+      presence |= HAS_CGI;
+      Store<std::uint8_t>(frame + layout.cgiSize + i, static_cast<std::uint8_t>(s1apOut.GetCgi()->size()));
+      WriteCgi(frame + layout.cgi + i * MAX_CGI_SIZE, s1apOut.GetCgi());
+    }
+
+    Store<std::uint8_t>(frame + layout.type + i, static_cast<std::uint8_t>(s1apOut.GetType()));
+    Store<std::uint8_t>(frame + layout.presence + i, presence);
+    Store<std::uint64_t>(frame + layout.imsi + i * 8, s1apOut.GetImsi());
+  }
+
+  return {};
+}
+
+std::expected<S1apCodec::FrameInfo, S1apCodec::Error> S1apCodec::PeekFrame(std::span<const std::byte> buffer)
+{
+  if (buffer.size() < HEADER_SIZE)
+    return std::unexpected(Error::BufferTooSmall);
+
+  const std::byte* p = buffer.data();
+
+  if (Load<std::uint32_t>(p) != MAGIC)
+    return std::unexpected(Error::BadMagic);
+
+  FrameInfo info{};
+
+  info.version = Load<std::uint16_t>(p + 4);
+  info.kind = static_cast<FrameKind>(Load<std::uint8_t>(p + 6));
+  info.count = Load<std::uint32_t>(p + 8);
+  info.size = Load<std::uint32_t>(p + 12);
+
+  if (info.version != VERSION)
+    return std::unexpected(Error::UnsupportedVersion);
+
+  std::size_t expectedSize = 0;
+
+  switch (info.kind)
+  {
+    case FrameKind::Events:
+      expectedSize = EventLayout(info.count).size;
+      break;
+
+    case FrameKind::Outs:
+      expectedSize = OutLayout(info.count).size;
+      break;
+
+    default:
+      return std::unexpected(Error::WrongFrameKind);
+  }
+
+  if (info.size != expectedSize)
+    return std::unexpected(Error::MalformedFrame);
+  if (buffer.size() < info.size)
+    return std::unexpected(Error::BufferTooSmall);
+
+  return info;
+}
+
+std::expected<S1apCodec::FrameInfo, S1apCodec::Error> S1apCodec::PeekFrame(std::span<const std::byte> buffer, FrameKind kind)
+{
+  auto info = PeekFrame(buffer);
+
+  if (info.has_value() && info->kind != kind)
+    return std::unexpected(Error::WrongFrameKind);
+
+  return info;
+}
+
+void S1apCodec::ValidateEvents(const std::uint8_t* types,
+                               const std::uint8_t* presence,
+                               const std::uint8_t* cgiSizes,
+                               std::size_t count,
+                               std::vector<std::uint64_t>& validBits)
+{
+  validBits.assign((count + 63) / 64, 0);
+  std::size_t i = 0;
+
+#if defined(__SSE2__)
+  const __m128i maxCgiSize = _mm_set1_epi8(static_cast<char>(MAX_CGI_SIZE));
+  const __m128i hasCgiBit = _mm_set1_epi8(static_cast<char>(HAS_CGI));
+
+  for (; i + 16 <= count; i += 16)
+  {
+    const __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(types + i));
+    const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(presence + i));
+    const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cgiSizes + i));
+
+    __m128i valid = _mm_setzero_si128();
+
+    for (std::size_t type = 0; type < EVENT_TYPE_COUNT; ++type)
+    {
+      const __m128i isType = _mm_cmpeq_epi8(t, _mm_set1_epi8(static_cast<char>(type)));
+      const __m128i isA = _mm_cmpeq_epi8(p, _mm_set1_epi8(static_cast<char>(VALID_PRESENCE_A[type])));
+      const __m128i isB = _mm_cmpeq_epi8(p, _mm_set1_epi8(static_cast<char>(VALID_PRESENCE_B[type])));
+
+      valid = _mm_or_si128(valid, _mm_and_si128(isType, _mm_or_si128(isA, isB)));
+    }
+
+    const __m128i cgiFits = _mm_cmpeq_epi8(_mm_min_epu8(c, maxCgiSize), c);
+    valid = _mm_and_si128(valid, cgiFits);
+
+    const __m128i hasCgi = _mm_cmpeq_epi8(_mm_and_si128(p, hasCgiBit), hasCgiBit);
+    const __m128i emptyCgi = _mm_cmpeq_epi8(c, _mm_setzero_si128());
+    valid = _mm_andnot_si128(_mm_and_si128(hasCgi, emptyCgi), valid);
+
+    const auto bits = static_cast<std::uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(valid)));
+    validBits[i / 64] |= bits << (i % 64);
+  }
+#endif
+
+  for (; i < count; ++i)
+    if (IsValidEventRecord(types[i], presence[i], cgiSizes[i]))
+      validBits[i / 64] |= std::uint64_t{1} << (i % 64);
+}
+
+S1apCodec::DecodeOut S1apCodec::Decode(std::span<const std::byte> buffer, std::vector<Event>& out)
+{
+  auto info = PeekFrame(buffer, FrameKind::Events);
+
+  if (!info.has_value())
+    return std::unexpected(info.error());
+
+  const std::size_t count = info->count;
+  const EventLayout layout(count);
+  const std::byte* frame = buffer.data();
+
+  const auto* types = reinterpret_cast<const std::uint8_t*>(frame + layout.type);
+  const auto* presence = reinterpret_cast<const std::uint8_t*>(frame + layout.presence);
+  const auto* cgiSizes = reinterpret_cast<const std::uint8_t*>(frame + layout.cgiSize);
+
+  thread_local std::vector<std::uint64_t> validBits;
+  ValidateEvents(types, presence, cgiSizes, count, validBits);
+
+  DecodeStats stats{};
+  stats.frameSize = info->size;
+  out.reserve(out.size() + count);
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    if (!(validBits[i / 64] & (std::uint64_t{1} << (i % 64)))) [[unlikely]]
+    {
+      ++stats.rejected;
+      continue;
+    }
+
+    const auto timestamp = Load<std::uint64_t>(frame + layout.timestamp + i * 8);
+    const auto imsi = Load<std::uint64_t>(frame + layout.imsi + i * 8);
+    const auto mTmsi = Load<std::uint32_t>(frame + layout.mTmsi + i * 4);
+    const auto enodebID = Load<std::uint32_t>(frame + layout.enodebID + i * 4);
+    const auto mmeID = Load<std::uint32_t>(frame + layout.mmeID + i * 4);
+    const std::byte* cgi = frame + layout.cgi + i * MAX_CGI_SIZE;
+
+    switch (static_cast<Event::Type>(types[i]))
+    {
+      case Event::Type::AttachRequest:
+        if (presence[i] & HAS_IMSI)
+          out.push_back(Event::CreateAttachRequestWithImsi(timestamp, imsi, enodebID, ReadCgi(cgi, cgiSizes[i])));
+        else
+          out.push_back(Event::CreateAttachRequestWithMTmsi(timestamp, enodebID, mTmsi, ReadCgi(cgi, cgiSizes[i])));
+        break;
+
+      case Event::Type::IdentityResponse:
+        out.push_back(Event::CreateIdentityResponse(timestamp, imsi, enodebID, mmeID, ReadCgi(cgi, cgiSizes[i])));
+        break;
+
+      case Event::Type::AttachAccept:
+        out.push_back(Event::CreateAttachAccept(timestamp, enodebID, mmeID, mTmsi));
+        break;
+
+      case Event::Type::Paging:
+        out.push_back(Event::CreatePaging(timestamp, mTmsi, ReadCgi(cgi, cgiSizes[i])));
+        break;
+
+      case Event::Type::PathSwitchRequest:
+        out.push_back(Event::CreatePathSwitchRequest(timestamp, enodebID, mmeID, ReadCgi(cgi, cgiSizes[i])));
+        break;
+
+      case Event::Type::PathSwitchRequestAcknowledge:
+        out.push_back(Event::CreatePathSwitchRequestAcknowledge(timestamp, enodebID, mmeID));
+        break;
+
+      case Event::Type::UEContextReleaseCommand:
+        out.push_back(Event::CreateUEContextReleaseCommand(timestamp, enodebID, mmeID, ReadCgi(cgi, cgiSizes[i])));
+        break;
+
+      case Event::Type::UEContextReleaseResponse:
+        out.push_back(Event::CreateUEContextReleaseResponse(timestamp, enodebID, mmeID));
+        break;
+    }
+
+    ++stats.decoded;
+  }
+
+  return stats;
+}
+
+S1apCodec::DecodeOut S1apCodec::Decode(std::span<const std::byte> buffer, std::vector<S1apOut>& out)
+{
+  auto info = PeekFrame(buffer, FrameKind::Outs);
+
+  if (!info.has_value())
+    return std::unexpected(info.error());
+
+  const std::size_t count = info->count;
+  const OutLayout layout(count);
+  const std::byte* frame = buffer.data();
+
+  DecodeStats stats{};
+  stats.frameSize = info->size;
+  out.reserve(out.size() + count);
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const auto type = Load<std::uint8_t>(frame + layout.type + i);
+    const auto presence = Load<std::uint8_t>(frame + layout.presence + i);
+    const auto cgiSize = Load<std::uint8_t>(frame + layout.cgiSize + i);
+    const auto imsi = Load<std::uint64_t>(frame + layout.imsi + i * 8);
+
+    if (type > static_cast<std::uint8_t>(S1apOut::Type::CgiChange)
+    ||  (presence & ~HAS_CGI) != 0
+    ||  cgiSize > MAX_CGI_SIZE)
+    {
+      ++stats.rejected;
+      continue;
+    }
+
+    if (presence & HAS_CGI)
+      out.emplace_back(static_cast<S1apOut::Type>(type), imsi, ReadCgi(frame + layout.cgi + i * MAX_CGI_SIZE, cgiSize));
+    else
+      out.emplace_back(static_cast<S1apOut::Type>(type), imsi, S1ap::OCgi{});
+
+    ++stats.decoded;
+  }
+
+  return stats;
+}
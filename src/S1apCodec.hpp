@@ -0,0 +1,119 @@
+#ifndef S1AP_CODEC_HPP
+#define S1AP_CODEC_HPP
+
+#include "S1apDB.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <vector>
+
+// Versioned binary frames of Event or S1apOut records.
+//
+// A frame is a 16 byte header followed by one column per field, every column
+// starting on an 8 byte boundary:
+//
+//   u32 magic | u16 version | u8 kind | u8 reserved | u32 count | u32 size
+//
+//   Event frame:  u8 type[n], u8 presence[n], u8 cgiSize[n], u64 timestamp[n],
+//                 u64 imsi[n], u32 mTmsi[n], u32 enodebID[n], u32 mmeID[n],
+//                 u8 cgi[n][MAX_CGI_SIZE]
+//
+//   S1apOut frame: u8 type[n], u8 presence[n], u8 cgiSize[n], u64 imsi[n],
+//                  u8 cgi[n][MAX_CGI_SIZE]
+//
+// All integers are little-endian, absent fields are zero. Decoding reads the
+// columns in place, so the buffer may be a mmap'd file or a receive buffer.
+class S1apCodec final
+{
+  public:
+    enum class Error
+    {
+      BufferTooSmall,
+      BadMagic,
+      UnsupportedVersion,
+      WrongFrameKind,
+      MalformedFrame,
+      CgiTooLong,
+      TooManyRecords,
+    };
+
+    enum class FrameKind : std::uint8_t
+    {
+      Events = 0,
+      Outs   = 1,
+    };
+
+    enum Presence : std::uint8_t
+    {
+      HAS_IMSI     = 1 << 0,
+      HAS_MTMSI    = 1 << 1,
+      HAS_ENODEBID = 1 << 2,
+      HAS_MMEID    = 1 << 3,
+      HAS_CGI      = 1 << 4,
+    };
+
+    static constexpr std::uint32_t MAGIC = 0x50413153; // "S1AP"
+    static constexpr std::uint16_t VERSION = 1;
+    static constexpr std::size_t HEADER_SIZE = 16;
+    static constexpr std::size_t MAX_CGI_SIZE = Event::MAX_CGI_SIZE;
+
+    struct FrameInfo
+    {
+      FrameKind kind;
+      std::uint16_t version;
+      std::uint32_t count;
+      std::uint32_t size;
+    };
+
+    struct DecodeStats
+    {
+      std::size_t frameSize = 0;
+      std::size_t decoded = 0;
+      std::size_t rejected = 0;
+    };
+
+    using EncodeOut = std::expected<void, Error>;
+    using DecodeOut = std::expected<DecodeStats, Error>;
+
+    // Append one frame holding all records to out.
+    static EncodeOut Encode(std::span<const Event> events, std::vector<std::byte>& out);
+    static EncodeOut Encode(std::span<const S1apOut> outs, std::vector<std::byte>& out);
+
+    // Validate the header of the frame at the start of buffer.
+    static std::expected<FrameInfo, Error> PeekFrame(std::span<const std::byte> buffer);
+
+    // Decode the frame at the start of buffer and append its records to out.
+    // Records that would not pass Event::Verify() are skipped and counted as
+    // rejected; the whole frame fails only when its layout is broken.
+    static DecodeOut Decode(std::span<const std::byte> buffer, std::vector<Event>& out);
+    static DecodeOut Decode(std::span<const std::byte> buffer, std::vector<S1apOut>& out);
+
+  private:
+    struct EventLayout
+    {
+      explicit EventLayout(std::size_t count);
+
+      std::size_t type, presence, cgiSize, timestamp, imsi, mTmsi, enodebID, mmeID, cgi, size;
+    };
+
+    struct OutLayout
+    {
+      explicit OutLayout(std::size_t count);
+
+      std::size_t type, presence, cgiSize, imsi, cgi, size;
+    };
+
+    static std::expected<FrameInfo, Error> PeekFrame(std::span<const std::byte> buffer, FrameKind kind);
+
+    // Bit i of the result is set when record i has a valid type, presence
+    // mask and CGI size. Processes 16 records per step where SSE2 is available.
+    static void ValidateEvents(const std::uint8_t* types,
+                               const std::uint8_t* presence,
+                               const std::uint8_t* cgiSizes,
+                               std::size_t count,
+                               std::vector<std::uint64_t>& validBits);
+};
+
+#endif // S1AP_CODEC_HPP
@@ -1,6 +1,9 @@
 #include "S1apDB.hpp"
+#include "S1apShardRouter.hpp"
 
+#include <algorithm>
 #include <print>
+#include <stdexcept>
 #include <utility>
 
 const Event::Type& Event::GetType() const { return type_; }
@@ -57,6 +60,11 @@ Event Event::CreateUEContextReleaseResponse(const S1ap::Timestamp timestamp,
 
 Event::VerifyOut Event::Verify() const
 {
+  // Whatever the type, a CGI that is there has to fit the codec and have a
+  // first byte: S1apCodec::Decode() applies the same rule.
+  if (cgi_.has_value() && (cgi_->empty() || cgi_->size() > MAX_CGI_SIZE))
+    return std::unexpected(Error::BadCgi);
+
   switch (type_)
   {
     case Type::AttachRequest:
@@ -194,21 +202,367 @@ S1ap::OMTmsi S1apDB::Subscriber::GetMTmsi() const { return mTmsi_; }
 S1ap::OEnodebID S1apDB::Subscriber::GetEnodebID() const { return enodebID_; }
 S1ap::OMmeID S1apDB::Subscriber::GetMmeID() const { return mmeID_; }
 
-const S1ap::OCgi& S1apDB::Subscriber::GetCgi() const { return cgi_; }
+S1ap::OCellID S1apDB::Subscriber::GetCellID() const { return cellID_; }
+void S1apDB::Subscriber::SetCellID(const S1ap::CellID cellID) { cellID_ = cellID; }
 
 Event::Type S1apDB::Subscriber::GetLastEventType() const { return eventType_; }
 S1ap::Timestamp S1apDB::Subscriber::GetLastEventTimestamp() const { return lastEventTimestamp_; }
 S1apDB::Subscriber::State S1apDB::Subscriber::GetState() const { return state_; }
 
+const S1apDB::Subscriber::StatsKey& S1apDB::Subscriber::GetStatsKey() const { return statsKey_; }
+void S1apDB::Subscriber::SetStatsKey(const StatsKey& statsKey) { statsKey_ = statsKey; }
+
+S1apDB::EventTrace* S1apDB::Subscriber::GetTrace() const { return trace_.get(); }
+void S1apDB::Subscriber::SetTrace(std::unique_ptr<EventTrace> trace) { trace_ = std::move(trace); }
+std::unique_ptr<S1apDB::EventTrace> S1apDB::Subscriber::TakeTrace() { return std::move(trace_); }
+
 S1apDB& S1apDB::GetInstance()
 {
   static S1apDB s1apDB{};
   return s1apDB;
 }
 
+namespace
+{
+  // An index past shardCount lands in M-TMSI bits no shard owns, so every
+  // M-TMSI it hands out would be refused or misrouted.
+  const S1apDB::ShardConfig& CheckShardConfig(const S1apDB::ShardConfig& shardConfig)
+  {
+    if (shardConfig.shardIndex >= std::max(shardConfig.shardCount, 1u))
+      throw std::invalid_argument("S1apDB: shardIndex must be below shardCount");
+
+    return shardConfig;
+  }
+}
+
+S1apDB::S1apDB(const ShardConfig& shardConfig)
+: shardConfig_(CheckShardConfig(shardConfig)),
+  shardBits_(S1apShardRouter::GetShardBits(shardConfig.shardCount)) {}
+
+S1apDB::S1apDB(const ShardConfig& shardConfig, const HugePageResource::Config& memoryConfig)
+: shardConfig_(CheckShardConfig(shardConfig)),
+  shardBits_(S1apShardRouter::GetShardBits(shardConfig.shardCount)),
+  hugePages_(std::make_unique<HugePageResource>(memoryConfig)),
+  pool_(std::make_unique<std::pmr::synchronized_pool_resource>(hugePages_.get())),
+  memory_(pool_.get()) {}
+
+void S1apDB::SetAdmissionConfig(const AdmissionConfig& config)
+{
+  admission_ = config;
+  enodebBuckets_.clear();
+  nextBucketSweepMs_ = 0;
+
+  if (config.globalEventsPerSecond > 0)
+    globalBucket_.emplace(config.globalEventsPerSecond, config.globalEventsPerSecond * config.burstSeconds);
+  else
+    globalBucket_.reset();
+}
+
+const S1apDB::AdmissionStats& S1apDB::GetAdmissionStats() const
+{
+  return admissionStats_;
+}
+
+bool S1apDB::Admit(const Event& event)
+{
+  const auto now = event.GetTimestamp();
+
+  // An event the global bucket turned away must not spend its eNodeB's budget.
+  bool admitted = !globalBucket_.has_value() || globalBucket_->TryTake(now);
+
+  if (admitted && admission_.enodebEventsPerSecond > 0 && event.GetEnodebID().has_value())
+  {
+    const auto enodebID = event.GetEnodebID().value();
+    auto it = enodebBuckets_.find(enodebID);
+
+    if (it == enodebBuckets_.end())
+    {
+      // Every bucket refills within one burst window, so sweeping more often
+      // than that cannot free more.
+      if (enodebBuckets_.size() >= MAX_ENODEB_BUCKETS && now >= nextBucketSweepMs_)
+      {
+        std::erase_if(enodebBuckets_, [now](const auto& entry) { return entry.second.IsFull(now); });
+        nextBucketSweepMs_ = now + static_cast<std::uint64_t>(admission_.burstSeconds * 1000.0);
+      }
+
+      if (enodebBuckets_.size() < MAX_ENODEB_BUCKETS)
+      {
+        const auto rate = admission_.enodebEventsPerSecond;
+        it = enodebBuckets_.try_emplace(enodebID, rate, rate * admission_.burstSeconds).first;
+      }
+    }
+
+    if (it != enodebBuckets_.end())
+      admitted = it->second.TryTake(now);
+  }
+
+  if (!admitted)
+    ++admissionStats_.overBudget;
+
+  return admitted;
+}
+
+HugePageResource::Stats S1apDB::GetMemoryStats() const
+{
+  return hugePages_ != nullptr ? hugePages_->GetStats() : HugePageResource::Stats{};
+}
+
 S1ap::MTmsi S1apDB::GenerateNewMTmsi()
 {
-  return nextMTmsi_++;
+  if (shardBits_ == 0)
+    return nextMTmsi_++;
+
+  // The owning shard sits in the top bits, like the MME code inside a GUTI,
+  // so any worker can route an M-TMSI without asking anyone.
+  const unsigned counterBits = 32 - shardBits_;
+  const S1ap::MTmsi counter = nextMTmsi_++ & ((S1ap::MTmsi{1} << counterBits) - 1);
+
+  return (static_cast<S1ap::MTmsi>(shardConfig_.shardIndex) << counterBits) | counter;
+}
+
+bool S1apDB::IsOwnMTmsi(S1ap::MTmsi mTmsi) const
+{
+  return shardBits_ == 0 || (mTmsi >> (32 - shardBits_)) == shardConfig_.shardIndex;
+}
+
+void S1apDB::SetLastEvent(Subscriber& subscriber, const Event& event)
+{
+  subscriber.SetLastEvent(event.GetType(), event.GetTimestamp());
+
+  if (subscriber.GetTrace() != nullptr) [[unlikely]]
+    NoteTrace(subscriber, subscriber.GetState(), subscriber.GetState(), event);
+}
+
+void S1apDB::SetSubscriberState(Subscriber& subscriber, const SubscriberState state, const Event& event)
+{
+  const auto oldState = subscriber.GetState();
+  subscriber.SetState(state);
+
+  if (subscriber.GetTrace() != nullptr) [[unlikely]]
+    NoteTrace(subscriber, oldState, state, event);
+
+  if (oldState == state)
+    return;
+
+  StateChange change{};
+
+  change.sequence = stateChanges_.GetTail();
+  change.timestamp = event.GetTimestamp();
+  change.imsi = subscriber.GetImsi().value();
+  change.cause = event.GetType();
+  change.oldState = oldState;
+  change.newState = state;
+
+  stateChanges_.Push(change);
+}
+
+const S1apDB::StateChangeFeed& S1apDB::GetStateChangeFeed() const
+{
+  return stateChanges_;
+}
+
+namespace
+{
+  std::uint32_t* SelectCounter(S1apDB::UeCounts& counts, S1apDB::SubscriberState state)
+  {
+    switch (state)
+    {
+      case S1apDB::SubscriberState::ATTACHED:
+        return &counts.attached;
+
+      case S1apDB::SubscriberState::PAGING_STATE:
+        return &counts.idle;
+
+      case S1apDB::SubscriberState::HANDOVER_STATE:
+        return &counts.handover;
+
+      default:
+        return nullptr;
+    }
+  }
+}
+
+void S1apDB::CountSubscriber(const Subscriber::StatsKey& statsKey, int delta)
+{
+  if (statsKey.enodebID.has_value())
+  {
+    if (auto* counter = SelectCounter(enodebCounts_[statsKey.enodebID.value()], statsKey.state))
+      *counter += delta;
+  }
+
+  if (statsKey.cellID.has_value())
+  {
+    if (statsKey.cellID.value() >= cellCounts_.size())
+      cellCounts_.resize(statsKey.cellID.value() + 1);
+
+    if (auto* counter = SelectCounter(cellCounts_[statsKey.cellID.value()], statsKey.state))
+      *counter += delta;
+  }
+}
+
+void S1apDB::UpdateSubscriberStats(Subscriber& subscriber)
+{
+  Subscriber::StatsKey statsKey{};
+
+  statsKey.enodebID = subscriber.GetEnodebID();
+  statsKey.cellID = subscriber.GetCellID();
+  statsKey.state = subscriber.GetState();
+
+  if (statsKey == subscriber.GetStatsKey())
+    return;
+
+  CountSubscriber(subscriber.GetStatsKey(), -1);
+  CountSubscriber(statsKey, +1);
+  subscriber.SetStatsKey(statsKey);
+}
+
+S1apDB::UeCounts S1apDB::GetEnodebCounts(S1ap::EnodebID enodebID) const
+{
+  const auto it = enodebCounts_.find(enodebID);
+  return it == enodebCounts_.end() ? UeCounts{} : it->second;
+}
+
+S1apDB::UeCounts S1apDB::GetCellCounts(const S1ap::Cgi& cgi) const
+{
+  const auto cellID = cgiPool_.Find(cgi);
+  return cellID.has_value() ? GetCellCounts(cellID.value()) : UeCounts{};
+}
+
+S1apDB::UeCounts S1apDB::GetCellCounts(S1ap::CellID cellID) const
+{
+  return cellID < cellCounts_.size() ? cellCounts_[cellID] : UeCounts{};
+}
+
+std::vector<S1apDB::CellCounts> S1apDB::GetTopCells(std::size_t n) const
+{
+  std::vector<S1ap::CellID> cellIDs(cellCounts_.size());
+  for (S1ap::CellID cellID = 0; cellID < cellIDs.size(); ++cellID)
+    cellIDs[cellID] = cellID;
+
+  n = std::min(n, cellIDs.size());
+
+  std::partial_sort(cellIDs.begin(), cellIDs.begin() + n, cellIDs.end(),
+                    [this](S1ap::CellID lhs, S1ap::CellID rhs) {
+                      return cellCounts_[lhs].attached > cellCounts_[rhs].attached;
+                    });
+
+  std::vector<CellCounts> top;
+  top.reserve(n);
+
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    const auto cgi = cgiPool_.GetCgi(cellIDs[i]);
+    top.push_back(CellCounts{cellIDs[i], S1ap::Cgi(cgi.begin(), cgi.end()), cellCounts_[cellIDs[i]]});
+  }
+
+  return top;
+}
+
+S1apDB::PublishedSubscriber S1apDB::MakePublishedSubscriber(S1ap::Imsi imsi, SubscriberState state, S1ap::OMTmsi mTmsi,
+                                                            S1ap::OEnodebID enodebID, S1ap::OMmeID mmeID,
+                                                            S1ap::OCellID cellID) const
+{
+  PublishedSubscriber published{};
+
+  published.imsi = imsi;
+  published.state = state;
+
+  if (mTmsi.has_value())
+  {
+    published.presence |= PublishedSubscriber::HAS_MTMSI;
+    published.mTmsi = mTmsi.value();
+  }
+
+  if (enodebID.has_value())
+  {
+    published.presence |= PublishedSubscriber::HAS_ENODEBID;
+    published.enodebID = enodebID.value();
+  }
+
+  if (mmeID.has_value())
+  {
+    published.presence |= PublishedSubscriber::HAS_MMEID;
+    published.mmeID = mmeID.value();
+  }
+
+  if (cellID.has_value())
+  {
+    const auto cgi = cgiPool_.GetCgi(cellID.value());
+
+    if (cgi.size() <= MAX_PUBLISHED_CGI_SIZE)
+    {
+      published.presence |= PublishedSubscriber::HAS_CGI;
+      published.cgiSize = static_cast<unsigned char>(cgi.size());
+      std::copy(cgi.begin(), cgi.end(), published.cgi.begin());
+    }
+  }
+
+  return published;
+}
+
+void S1apDB::PublishSubscriber(Subscriber& subscriber)
+{
+  UpdateSubscriberStats(subscriber);
+
+  const auto published = MakePublishedSubscriber(subscriber.GetImsi().value(), subscriber.GetState(),
+                                                 subscriber.GetMTmsi(), subscriber.GetEnodebID(),
+                                                 subscriber.GetMmeID(), subscriber.GetCellID());
+
+  publishedSubscribers_.Store(published.imsi, published);
+
+  if (subscriber.GetMTmsi().has_value())
+    publishedMTmsiToImsi_.Store(published.mTmsi, published.imsi);
+}
+
+void S1apDB::UnpublishSubscriber(Subscriber& subscriber)
+{
+  CountSubscriber(subscriber.GetStatsKey(), -1);
+  subscriber.SetStatsKey({});
+
+  if (subscriber.GetMTmsi().has_value())
+    publishedMTmsiToImsi_.Erase(subscriber.GetMTmsi().value());
+
+  publishedSubscribers_.Erase(subscriber.GetImsi().value());
+}
+
+std::optional<S1apDB::SubscriberView> S1apDB::Lookup(S1ap::Imsi imsi) const
+{
+  const auto published = publishedSubscribers_.Load(imsi);
+
+  if (!published.has_value())
+    return std::nullopt;
+
+  SubscriberView view{};
+
+  view.imsi = published->imsi;
+  view.state = published->state;
+
+  if (published->presence & PublishedSubscriber::HAS_MTMSI)
+    view.mTmsi = published->mTmsi;
+  if (published->presence & PublishedSubscriber::HAS_ENODEBID)
+    view.enodebID = published->enodebID;
+  if (published->presence & PublishedSubscriber::HAS_MMEID)
+    view.mmeID = published->mmeID;
+  if (published->presence & PublishedSubscriber::HAS_CGI)
+    view.cgi.emplace(published->cgi.begin(), published->cgi.begin() + published->cgiSize);
+
+  return view;
+}
+
+std::optional<S1apDB::SubscriberView> S1apDB::LookupByMTmsi(S1ap::MTmsi mTmsi) const
+{
+  const auto imsi = publishedMTmsiToImsi_.Load(mTmsi);
+
+  if (!imsi.has_value())
+    return std::nullopt;
+
+  // The two tables are updated separately, so the record may already belong
+  // to a newer M-TMSI of the same subscriber.
+  auto view = Lookup(imsi.value());
+  if (!view.has_value() || view->mTmsi != mTmsi)
+    return std::nullopt;
+
+  return view;
 }
 
 S1apDB::HandleOut S1apDB::ProcessNewAttach(const Event& event)
@@ -218,19 +572,20 @@ S1apDB::HandleOut S1apDB::ProcessNewAttach(const Event& event)
   Subscriber newSubscriber;
 
   newSubscriber.SetImsi(imsi);
-  newSubscriber.SetLastEvent(event.GetType(), event.GetTimestamp());
-  newSubscriber.SetState(Subscriber::State::ATTACHED);
+  StartTrace(newSubscriber);
+  SetLastEvent(newSubscriber, event);
+  SetSubscriberState(newSubscriber, Subscriber::State::ATTACHED, event);
   newSubscriber.SetEnodebID(event.GetEnodebID().value());
 
-  if (event.GetCgi().has_value())
-    newSubscriber.SetCgi(event.GetCgi().value());
+  SetSubscriberCgi(newSubscriber, event);
 
-  imsiToSubscriber[imsi] = newSubscriber;
+  imsiToSubscriber[imsi] = std::move(newSubscriber);
 
   auto newMTmsi = GenerateNewMTmsi();
   imsiToSubscriber[imsi].SetMTmsi(newMTmsi);
   mTmsiToImsi[newMTmsi] = imsi;
-  enodebIDToImsi[newSubscriber.GetEnodebID().value()] = imsi;
+  enodebIDToImsi[event.GetEnodebID().value()] = imsi;
+  PublishSubscriber(imsiToSubscriber[imsi]);
 
   std::println("MME: User {} attached. Assigned MTmsi: {}", imsi, newMTmsi);
 
@@ -239,32 +594,33 @@ S1apDB::HandleOut S1apDB::ProcessNewAttach(const Event& event)
 
 S1apDB::HandleOut S1apDB::ProcessExistingAttach(Subscriber& subscriber, const Event& event)
 {
-  subscriber.SetState(Subscriber::State::ATTACHED);
+  SetSubscriberState(subscriber, Subscriber::State::ATTACHED, event);
   subscriber.SetEnodebID(event.GetEnodebID().value());
 
-  if (event.GetCgi().has_value())
-    subscriber.SetCgi(event.GetCgi().value());
+  SetSubscriberCgi(subscriber, event);
 
-  subscriber.SetLastEvent(event.GetType(), event.GetTimestamp());
+  SetLastEvent(subscriber, event);
 
   const auto currentMTmsi = subscriber.GetMTmsi().value_or(GenerateNewMTmsi());
 
   if (!subscriber.GetMTmsi().has_value())
   {
     subscriber.SetMTmsi(currentMTmsi);
-    mTmsiToImsi[currentMTmsi] = event.GetImsi().value();
+    mTmsiToImsi[currentMTmsi] = subscriber.GetImsi().value();
   }
 
   enodebIDToImsi[event.GetEnodebID().value()] = subscriber.GetImsi().value();
-  std::println("MME: User {} re-attached. Current MTmsi: {}", event.GetImsi().value(), currentMTmsi);
+  PublishSubscriber(subscriber);
 
-  return S1apOut(S1apOut::Type::Reg, event.GetImsi().value(), event.GetCgi());
+  std::println("MME: User {} re-attached. Current MTmsi: {}", subscriber.GetImsi().value(), currentMTmsi);
+
+  return S1apOut(S1apOut::Type::Reg, subscriber.GetImsi().value(), event.GetCgi());
 }
 
 S1apDB::HandleOut S1apDB::ProcessDuplicateAttach(Subscriber& subscriber, const Event& event)
 {
-  subscriber.SetLastEvent(event.GetType(), event.GetTimestamp());
-  std::println("MME: User {} already attached. Ignoring duplicate Attach Request.", event.GetImsi().value());
+  SetLastEvent(subscriber, event);
+  std::println("MME: User {} already attached. Ignoring duplicate Attach Request.", subscriber.GetImsi().value());
 
   return std::nullopt;
 }
@@ -277,18 +633,19 @@ S1apDB::HandleOut S1apDB::ProcessIdentityResponseForNewUser(const Event& event)
   auto& newSubscriber = imsiToSubscriber[imsi];
 
   newSubscriber.SetImsi(imsi);
-  newSubscriber.SetLastEvent(event.GetType(), event.GetTimestamp());
-  newSubscriber.SetState(Subscriber::State::ATTACHED);
+  StartTrace(newSubscriber);
+  SetLastEvent(newSubscriber, event);
+  SetSubscriberState(newSubscriber, Subscriber::State::ATTACHED, event);
   newSubscriber.SetEnodebID(event.GetEnodebID().value());
 
-  if (event.GetCgi().has_value())
-    newSubscriber.SetCgi(event.GetCgi().value());
+  SetSubscriberCgi(newSubscriber, event);
 
   auto newMTmsi = GenerateNewMTmsi();
   imsiToSubscriber[imsi].SetMTmsi(newMTmsi);
   mTmsiToImsi[newMTmsi] = imsi;
   enodebIDToImsi[event.GetEnodebID().value()] = imsi;
   imsiToIdentityRequestTimeout_.erase(imsi);
+  PublishSubscriber(newSubscriber);
 
   std::println("MME: Received Identity Response for user {}. User attached. Assigned MTmsi: {}", imsi, newMTmsi);
   return S1apOut(S1apOut::Type::Reg, imsi, event.GetCgi());
@@ -296,12 +653,11 @@ S1apDB::HandleOut S1apDB::ProcessIdentityResponseForNewUser(const Event& event)
 
 S1apDB::HandleOut S1apDB::ProcessIdentityResponseForAttachingUser(Subscriber& subscriber, const Event& event)
 {
-  subscriber.SetState(Subscriber::State::ATTACHED);
-  subscriber.SetLastEvent(event.GetType(), event.GetTimestamp());
+  SetSubscriberState(subscriber, Subscriber::State::ATTACHED, event);
+  SetLastEvent(subscriber, event);
   subscriber.SetEnodebID(event.GetEnodebID().value());
 
-  if (event.GetCgi().has_value())
-    subscriber.SetCgi(event.GetCgi().value());
+  SetSubscriberCgi(subscriber, event);
 
   auto currentMTmsi = subscriber.GetMTmsi().value_or(GenerateNewMTmsi());
 
@@ -313,6 +669,7 @@ S1apDB::HandleOut S1apDB::ProcessIdentityResponseForAttachingUser(Subscriber& su
 
   enodebIDToImsi[event.GetEnodebID().value()] = subscriber.GetImsi().value();
   imsiToIdentityRequestTimeout_.erase(event.GetImsi().value());
+  PublishSubscriber(subscriber);
 
   std::println("MME: User {} moved from ATTACHING to ATTACHED. Current MTmsi: {}", event.GetImsi().value(), currentMTmsi);
   return S1apOut(S1apOut::Type::Reg, event.GetImsi().value(), event.GetCgi());
@@ -329,8 +686,9 @@ S1apDB::HandleOut S1apDB::ProcessPagingRequest(Subscriber& subscriber, const Eve
     return std::nullopt;
   }
 
-  subscriber.SetLastEvent(event.GetType(), event.GetTimestamp());
-  subscriber.SetState(Subscriber::State::PAGING_STATE);
+  SetLastEvent(subscriber, event);
+  SetSubscriberState(subscriber, Subscriber::State::PAGING_STATE, event);
+  PublishSubscriber(subscriber);
 
   std::println("MME: Paging for user {} (MTmsi: {}). Changing state to PAGING_STATE.",
                subscriber.GetImsi().value(), event.GetMTmsi().value());
@@ -351,12 +709,14 @@ S1apDB::HandleOut S1apDB::ProcessPathSwitchRequest(Subscriber& subscriber, const
   auto oldEnodebID = event.GetEnodebID().value();
   auto newEnodebID = event.GetCgi().value().front(); // Assuming CGI contains the new eNodeB ID
 
-  subscriber.SetLastEvent(event.GetType(), event.GetTimestamp());
+  SetLastEvent(subscriber, event);
   subscriber.SetEnodebID(newEnodebID);
-  subscriber.SetState(Subscriber::State::HANDOVER_STATE);
+  SetSubscriberCgi(subscriber, event);
+  SetSubscriberState(subscriber, Subscriber::State::HANDOVER_STATE, event);
 
   enodebIDToImsi.erase(oldEnodebID);
   enodebIDToImsi[newEnodebID] = subscriber.GetImsi().value();
+  PublishSubscriber(subscriber);
 
   std::println("MME: Path Switch Request for user {}. Moved from eNodeB {} to {}.",
                subscriber.GetImsi().value(), oldEnodebID, newEnodebID);
@@ -367,24 +727,57 @@ S1apDB::HandleOut S1apDB::ProcessPathSwitchRequest(Subscriber& subscriber, const
 S1apDB::HandleOut S1apDB::ProcessUEContextRelease(Subscriber& subscriber, const Event& event)
 {
   auto imsi = subscriber.GetImsi().value();
-  
-  subscriber.SetState(Subscriber::State::DETACHED);
-  subscriber.SetLastEvent(event.GetType(), event.GetTimestamp());
+  auto cgi = GetSubscriberCgi(subscriber);
+
+  SetSubscriberState(subscriber, Subscriber::State::DETACHED, event);
+  SetLastEvent(subscriber, event);
 
   DetachSubscriber(subscriber);
-  
+
   std::println("MME: UE Context for user {} released. User detached.", imsi);
-  return S1apOut(S1apOut::Type::UnReg, imsi, subscriber.GetCgi());
+  return S1apOut(S1apOut::Type::UnReg, imsi, std::move(cgi));
+}
+
+void S1apDB::SetSubscriberCgi(Subscriber& subscriber, const Event& event)
+{
+  if (event.GetCgi().has_value())
+    subscriber.SetCellID(cgiPool_.Intern(event.GetCgi().value()));
+}
+
+S1ap::OCgi S1apDB::GetSubscriberCgi(const Subscriber& subscriber) const
+{
+  if (!subscriber.GetCellID().has_value())
+    return std::nullopt;
+
+  const auto cgi = cgiPool_.GetCgi(subscriber.GetCellID().value());
+  return S1ap::Cgi(cgi.begin(), cgi.end());
+}
+
+const CgiPool& S1apDB::GetCgiPool() const
+{
+  return cgiPool_;
 }
 
 void S1apDB::DetachSubscriber(Subscriber& subscriber)
 {
+  UnpublishSubscriber(subscriber);
+
   if (subscriber.GetMTmsi().has_value())
     mTmsiToImsi.erase(subscriber.GetMTmsi().value());
 
   if (subscriber.GetEnodebID().has_value())
     enodebIDToImsi.erase(subscriber.GetEnodebID().value());
 
+  // Only watchlisted rings outlive the record, which bounds them by the
+  // watchlist; a sampled subscriber starts afresh on its next attach.
+  if (subscriber.GetTrace() != nullptr) [[unlikely]]
+  {
+    if (traceWatchlist_.contains(subscriber.GetImsi().value()))
+      detachedTraces_[subscriber.GetImsi().value()] = subscriber.TakeTrace();
+    else if (pendingTrace_.trace == subscriber.GetTrace())
+      pendingTrace_.trace = nullptr;
+  }
+
   imsiToSubscriber.erase(subscriber.GetImsi().value());
 }
 
@@ -392,9 +785,28 @@ S1apDB::HandleOut S1apDB::Handle(const Event& event)
 {
   auto verifyResult = event.Verify();
 
-  if (!verifyResult.has_value())
+  if (!verifyResult.has_value()) [[unlikely]]
     return std::unexpected(verifyResult.error());
 
+  overloaded_ = !Admit(event);
+
+  if (overloaded_ && event.GetType() == Event::Type::Paging) [[unlikely]]
+  {
+    ++admissionStats_.shedPaging;
+    return std::unexpected(Error::Overloaded);
+  }
+
+  auto out = Dispatch(event);
+  stateChanges_.Publish();
+
+  if (pendingTrace_.trace != nullptr) [[unlikely]]
+    FlushTrace(event);
+
+  return out;
+}
+
+S1apDB::HandleOut S1apDB::Dispatch(const Event& event)
+{
   switch (event.GetType())
   {
     case Event::Type::AttachRequest:
@@ -421,7 +833,7 @@ S1apDB::HandleOut S1apDB::Handle(const Event& event)
     case Event::Type::UEContextReleaseCommand:
       return HandleUEContextReleaseCommand(event);
 
-    default:
+    [[unlikely]] default:
       return std::unexpected(Event::Error::WrongEventType);
   }
 }
@@ -429,7 +841,10 @@ S1apDB::HandleOut S1apDB::Handle(const Event& event)
 S1apDB::HandleOut S1apDB::HandleAttachRequest(const Event& event)
 {
   auto imsiResult = ResolveImsiFromEvent(event);
-  if (!imsiResult.has_value()) {
+  if (!imsiResult.has_value()) [[unlikely]] {
+    if (imsiResult.error() == HandleError(Error::WrongShard))
+      return std::unexpected(imsiResult.error());
+
     if (event.GetMTmsi().has_value())
     {
        std::println("MME: Received Attach Request with unknown MTmsi: {}. Sending Identity Request.", event.GetMTmsi().value());
@@ -448,7 +863,15 @@ S1apDB::HandleOut S1apDB::HandleAttachRequest(const Event& event)
   Subscriber& subscriber = it->second;
 
   if (subscriber.GetState() == Subscriber::State::ATTACHED)
+  {
+    if (overloaded_) [[unlikely]]
+    {
+      ++admissionStats_.shedDuplicateAttach;
+      return std::unexpected(Error::Overloaded);
+    }
+
     return ProcessDuplicateAttach(subscriber, event);
+  }
 
   return ProcessExistingAttach(subscriber, event);
 }
@@ -542,8 +965,9 @@ S1apDB::HandleOut S1apDB::HandleAttachAccept(const Event& event) {
     return std::unexpected(Error::WrongState);
   }
 
-  subscriber.SetState(Subscriber::State::ATTACHED);
-  subscriber.SetLastEvent(event.GetType(), event.GetTimestamp());
+  SetSubscriberState(subscriber, Subscriber::State::ATTACHED, event);
+  SetLastEvent(subscriber, event);
+  PublishSubscriber(subscriber);
 
   std::println("MME: Attach Accept for user {}. State changed to ATTACHED.", imsi.value());
 
@@ -564,6 +988,9 @@ std::expected<S1ap::Imsi, S1apDB::HandleError> S1apDB::ResolveImsiFromEvent(cons
 
   if (event.GetMTmsi().has_value())
   {
+    if (!IsOwnMTmsi(event.GetMTmsi().value())) [[unlikely]]
+      return std::unexpected(Error::WrongShard);
+
     auto it = mTmsiToImsi.find(event.GetMTmsi().value());
     if (it != mTmsiToImsi.end())
       return it->second;
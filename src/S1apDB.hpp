@@ -1,10 +1,23 @@
 #ifndef S1AP_DB_HPP
 #define S1AP_DB_HPP
 
+#include "BroadcastRing.hpp"
+#include "CgiPool.hpp"
+#include "HugePageResource.hpp"
+#include "SeqlockTable.hpp"
+#include "TokenBucket.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <expected>
+#include <memory>
+#include <memory_resource>
 #include <optional>
+#include <span>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -194,6 +207,10 @@ class Event final
     using VerifyOut = std::expected<void, Error>;
     VerifyOut Verify() const;
 
+    // Longest CGI an event may carry; snapshots and codec frames rely on it.
+    // A CGI, when present, is never empty.
+    static constexpr std::size_t MAX_CGI_SIZE = 16;
+
   private:
     Event() = default;
 
@@ -257,19 +274,177 @@ class S1apDB final
       NoImsiOrMTmsiInEvent,
       TimeoutOccurred,
       WrongState,
+      WrongShard,
+      BadSnapshot,
+      BadImport,
+      Overloaded,
     };
 
+    // Position of this instance when subscribers are partitioned across
+    // several S1apDB instances. Every M-TMSI it allocates carries shardIndex
+    // in its top bits, see S1apShardRouter. The constructors throw
+    // std::invalid_argument unless shardIndex < shardCount.
+    struct ShardConfig
+    {
+      unsigned shardCount = 1;
+      unsigned shardIndex = 0;
+    };
+
+    S1apDB() = default;
+    explicit S1apDB(const ShardConfig& shardConfig);
+
+    // Keeps the subscriber store and its indexes on huge pages bound to a
+    // NUMA node, by default the node of the constructing thread, so build
+    // each shard on its owner thread.
+    S1apDB(const ShardConfig& shardConfig, const HugePageResource::Config& memoryConfig);
+
     using HandleError = std::variant<Error, Event::Error>;
     using HandleOut   = std::expected<std::optional<S1apOut>, HandleError>;
 
+    enum class SubscriberState
+    {
+      DETACHED,
+      ATTACHING,
+      ATTACHED,
+      PAGING_STATE,
+      SERVICE_REQUEST_PENDING,
+      HANDOVER_STATE,
+      RELEASING,
+    };
+
+    struct SubscriberView
+    {
+      S1ap::Imsi imsi;
+      S1ap::OMTmsi mTmsi         = std::nullopt;
+      S1ap::OEnodebID enodebID   = std::nullopt;
+      S1ap::OMmeID mmeID         = std::nullopt;
+      S1ap::OCgi cgi             = std::nullopt;
+      SubscriberState state      = SubscriberState::DETACHED;
+    };
+
+    struct StateChange
+    {
+      std::uint64_t sequence;
+      S1ap::Timestamp timestamp;
+      S1ap::Imsi imsi;
+      Event::Type cause;
+      SubscriberState oldState;
+      SubscriberState newState;
+    };
+
+    using StateChangeFeed = BroadcastRing<StateChange>;
+
     HandleOut Handle(const Event& event);
     void HandleTimeouts(S1ap::Timestamp currentTimestamp);
 
+    // Read-only queries. Safe to call from any number of threads concurrently
+    // with the single thread calling Handle(); they never block it.
+    std::optional<SubscriberView> Lookup(S1ap::Imsi imsi) const;
+    std::optional<SubscriberView> LookupByMTmsi(S1ap::MTmsi mTmsi) const;
+
+    // UEs counted per eNodeB and per cell. Maintained incrementally by the
+    // state machine; like Handle(), only call these from the writer thread.
+    struct UeCounts
+    {
+      std::uint32_t attached = 0;   // ATTACHED
+      std::uint32_t idle = 0;       // PAGING_STATE
+      std::uint32_t handover = 0;   // HANDOVER_STATE
+    };
+
+    struct CellCounts
+    {
+      S1ap::CellID cellID;
+      S1ap::Cgi cgi;
+      UeCounts counts;
+    };
+
+    UeCounts GetEnodebCounts(S1ap::EnodebID enodebID) const;
+    UeCounts GetCellCounts(const S1ap::Cgi& cgi) const;
+    UeCounts GetCellCounts(S1ap::CellID cellID) const;
+
+    // The n cells with the most attached UEs, busiest first.
+    std::vector<CellCounts> GetTopCells(std::size_t n) const;
+
+    // CGIs are interned per S1apDB instance.
+    const CgiPool& GetCgiPool() const;
+
+    // Every subscriber state transition, published once per Handle() call.
+    // Consumers on any thread tail it through their own cursor.
+    const StateChangeFeed& GetStateChangeFeed() const;
+
+    // Full state with subscribers ordered by IMSI, so equal states give equal
+    // bytes. LoadSnapshot() replaces the current state; the shard
+    // configuration is not part of it. Writer thread only.
+    std::vector<std::byte> SaveSnapshot() const;
+    std::expected<void, Error> LoadSnapshot(std::span<const std::byte> snapshot);
+
+    // Subscriber contexts only, one column per field, for provisioning or
+    // migrating a large population at once. ImportSubscribers() replaces the
+    // current state and builds the indexes in parallel; a rejected import
+    // leaves it untouched. Pending identity request timeouts and last-event
+    // history are not carried. Writer thread only.
+    std::vector<std::byte> ExportSubscribers() const;
+    std::expected<std::size_t, Error> ImportSubscribers(std::span<const std::byte> bulk);
+
+    // Event budgets in events/s, refilled from event timestamps; zero leaves
+    // a budget unlimited. Every event draws on the global bucket and, when it
+    // names one and the global bucket admitted it, on its eNodeB's bucket.
+    // While either is empty, paging and duplicate attaches are shed with
+    // Error::Overloaded; other events are still handled. At most
+    // MAX_ENODEB_BUCKETS eNodeBs are tracked: refilled buckets are forgotten
+    // to make room, and an eNodeB that finds no room only draws on the global
+    // bucket. Writer thread only.
+    struct AdmissionConfig
+    {
+      double globalEventsPerSecond = 0;
+      double enodebEventsPerSecond = 0;
+      double burstSeconds = 1.0;   // bucket size, in seconds of budget
+    };
+
+    struct AdmissionStats
+    {
+      std::uint64_t shedPaging = 0;
+      std::uint64_t shedDuplicateAttach = 0;
+      std::uint64_t overBudget = 0;   // events that found a bucket empty
+    };
+
+    void SetAdmissionConfig(const AdmissionConfig& config);
+    const AdmissionStats& GetAdmissionStats() const;
+
+    // Opt-in history of the last TRACE_DEPTH events of chosen subscribers:
+    // those on the watchlist, plus one in sampleOneIn picked by IMSI hash
+    // (zero samples none). Rings of watchlisted subscribers are kept across
+    // detach and re-attach, so detached rings never outnumber the watchlist;
+    // a sampled subscriber's ring goes with its record. Untraced subscribers
+    // pay one pointer and a branch per update. Writer thread only.
+    static constexpr std::size_t TRACE_DEPTH = 16;
+
+    struct TraceConfig
+    {
+      std::vector<S1ap::Imsi> watchlist;
+      unsigned sampleOneIn = 0;
+    };
+
+    struct TraceEntry
+    {
+      S1ap::Timestamp timestamp;
+      Event::Type cause;
+      SubscriberState oldState;
+      SubscriberState newState;
+    };
+
+    void SetTraceConfig(const TraceConfig& config);
+
+    // Oldest first; empty when the subscriber is not traced.
+    std::vector<TraceEntry> GetTrace(S1ap::Imsi imsi) const;
+
+    // Zero when the instance was built without huge pages.
+    HugePageResource::Stats GetMemoryStats() const;
+
     static S1apDB& GetInstance();
 
   private:
-    S1apDB() = default;
-
+    HandleOut Dispatch(const Event& event);
     HandleOut HandleAttachRequest(const Event& event);
     HandleOut HandleIdentityResponse(const Event& event);
     HandleOut HandleAttachAccept(const Event& event);
@@ -279,32 +454,50 @@ class S1apDB final
     HandleOut HandleUEContextReleaseCommand(const Event& event);
     HandleOut HandleUEContextReleaseResponse(const Event& event);
 
+    void Clear();
+
+    bool Admit(const Event& event);
+
     S1ap::MTmsi GenerateNewMTmsi();
+    bool IsOwnMTmsi(S1ap::MTmsi mTmsi) const;
 
-    S1ap::MTmsi nextMTmsi_ = 1000; 
+    ShardConfig shardConfig_{};
+    unsigned shardBits_ = 0;
+    S1ap::MTmsi nextMTmsi_ = 1000;
 
-    class Subscriber
+    // Events handled for a subscriber, one entry per event. Handle() writes
+    // it once the event is done, from the state before its first touch of
+    // the subscriber to the state after the last.
+    class EventTrace
     {
       public:
-        enum class State
+        void Record(const TraceEntry& entry);
+        std::vector<TraceEntry> GetEntries() const;
+
+      private:
+        struct Packed
         {
-          DETACHED,
-          ATTACHING,
-          ATTACHED,
-          PAGING_STATE,
-          SERVICE_REQUEST_PENDING,
-          HANDOVER_STATE,
-          RELEASING,
+          S1ap::Timestamp timestamp;
+          std::uint8_t cause;
+          std::uint8_t oldState;
+          std::uint8_t newState;
         };
 
+        std::array<Packed, TRACE_DEPTH> entries_{};
+        std::size_t count_ = 0;   // recorded so far, the ring keeps the last TRACE_DEPTH
+    };
+
+    class Subscriber
+    {
+      public:
+        using State = SubscriberState;
+
         void SetLastEvent(const Event::Type eventType, const S1ap::Timestamp timestamp);
         void SetMTmsi(const S1ap::MTmsi mTmsi);
         void SetEnodebID(const S1ap::EnodebID enodebID);
         void SetMmeID(const S1ap::MmeID mmeID);
         void SetState(const State state);
-
-        template <IsCgiCompatible CgiArg>
-        void SetCgi(CgiArg&& cgi) { cgi_ = std::forward<S1ap::OCgi>(cgi); }
+        void SetCellID(const S1ap::CellID cellID);
 
         void SetImsi(S1ap::Imsi imsi);
 
@@ -312,30 +505,97 @@ class S1apDB final
         S1ap::OMTmsi GetMTmsi() const;
         S1ap::OEnodebID GetEnodebID() const;
         S1ap::OMmeID GetMmeID() const;
-        const S1ap::OCgi& GetCgi() const;
+        S1ap::OCellID GetCellID() const;
 
         Event::Type GetLastEventType() const;
         S1ap::Timestamp GetLastEventTimestamp() const;
 
         State GetState() const;
 
+        // Where the subscriber is currently counted in the UE statistics.
+        struct StatsKey
+        {
+          S1ap::OEnodebID enodebID = std::nullopt;
+          S1ap::OCellID cellID     = std::nullopt;
+          State state              = State::DETACHED;
+
+          bool operator==(const StatsKey&) const = default;
+        };
+
+        const StatsKey& GetStatsKey() const;
+        void SetStatsKey(const StatsKey& statsKey);
+
+        EventTrace* GetTrace() const;
+        void SetTrace(std::unique_ptr<EventTrace> trace);
+        std::unique_ptr<EventTrace> TakeTrace();
+
       private:
         S1ap::OImsi imsi_          = std::nullopt;
         S1ap::OMTmsi mTmsi_        = std::nullopt;
         S1ap::OEnodebID enodebID_  = std::nullopt;
         S1ap::OMmeID mmeID_        = std::nullopt;
 
-        S1ap::OCgi cgi_ = std::nullopt;
+        S1ap::OCellID cellID_ = std::nullopt;
 
         State state_ = State::DETACHED;
 
         Event::Type eventType_;
         S1ap::Timestamp lastEventTimestamp_;
+
+        StatsKey statsKey_{};
+
+        std::unique_ptr<EventTrace> trace_;   // null unless traced
     };
 
     std::expected<S1ap::Imsi, HandleError> ResolveImsiFromEvent(const Event& event) const;
     std::expected<S1ap::Imsi, HandleError> ResolveImsiFromEnodebID(S1ap::EnodebID enodebID) const;
     void DetachSubscriber(Subscriber& subscriber);
+    void SetSubscriberCgi(Subscriber& subscriber, const Event& event);
+    S1ap::OCgi GetSubscriberCgi(const Subscriber& subscriber) const;
+
+    // Copy of a subscriber record that readers get through the seqlock tables.
+    // CGIs longer than the inline buffer are published as absent.
+    static constexpr std::size_t MAX_PUBLISHED_CGI_SIZE = 16;
+
+    struct PublishedSubscriber
+    {
+      enum Presence : unsigned char
+      {
+        HAS_MTMSI    = 1 << 0,
+        HAS_ENODEBID = 1 << 1,
+        HAS_MMEID    = 1 << 2,
+        HAS_CGI      = 1 << 3,
+      };
+
+      S1ap::Imsi imsi;
+      S1ap::MTmsi mTmsi;
+      S1ap::EnodebID enodebID;
+      S1ap::MmeID mmeID;
+      SubscriberState state;
+      unsigned char presence;
+      unsigned char cgiSize;
+      std::array<unsigned char, MAX_PUBLISHED_CGI_SIZE> cgi;
+    };
+
+    // The one place a PublishedSubscriber is built, for PublishSubscriber()
+    // and for bulk import, which publishes before the records exist.
+    PublishedSubscriber MakePublishedSubscriber(S1ap::Imsi imsi, SubscriberState state, S1ap::OMTmsi mTmsi,
+                                                S1ap::OEnodebID enodebID, S1ap::OMmeID mmeID,
+                                                S1ap::OCellID cellID) const;
+
+    void SetSubscriberState(Subscriber& subscriber, const SubscriberState state, const Event& event);
+    void SetLastEvent(Subscriber& subscriber, const Event& event);
+
+    bool IsTraced(S1ap::Imsi imsi) const;
+    void StartTrace(Subscriber& subscriber);
+    void NoteTrace(const Subscriber& subscriber, SubscriberState oldState, SubscriberState newState, const Event& event);
+    void FlushTrace(const Event& event);
+
+    void PublishSubscriber(Subscriber& subscriber);
+    void UnpublishSubscriber(Subscriber& subscriber);
+
+    void CountSubscriber(const Subscriber::StatsKey& statsKey, int delta);
+    void UpdateSubscriberStats(Subscriber& subscriber);
 
     HandleOut ProcessNewAttach(const Event& event);
     HandleOut ProcessExistingAttach(Subscriber& subscriber, const Event& event);
@@ -346,10 +606,51 @@ class S1apDB final
     HandleOut ProcessPathSwitchRequest(Subscriber& subscriber, const Event& event);
     HandleOut ProcessUEContextRelease(Subscriber& subscriber, const Event& event);
 
-    std::unordered_map<S1ap::Imsi, Subscriber> imsiToSubscriber;
-    std::unordered_map<S1ap::MTmsi, S1ap::Imsi> mTmsiToImsi;
-    std::unordered_map<S1ap::EnodebID, S1ap::Imsi> enodebIDToImsi;
-    std::unordered_map<S1ap::MmeID, S1ap::Imsi> mmeIDToImsi;
+    // Declared ahead of everything allocated from them.
+    std::unique_ptr<HugePageResource> hugePages_;
+    std::unique_ptr<std::pmr::synchronized_pool_resource> pool_;
+    std::pmr::memory_resource* memory_ = std::pmr::get_default_resource();
+
+    std::pmr::unordered_map<S1ap::Imsi, Subscriber> imsiToSubscriber{memory_};
+    std::pmr::unordered_map<S1ap::MTmsi, S1ap::Imsi> mTmsiToImsi{memory_};
+    std::pmr::unordered_map<S1ap::EnodebID, S1ap::Imsi> enodebIDToImsi{memory_};
+    std::pmr::unordered_map<S1ap::MmeID, S1ap::Imsi> mmeIDToImsi{memory_};
+
+    static constexpr std::size_t PUBLISHED_TABLE_CAPACITY = 1024;
+    SeqlockTable<S1ap::Imsi, PublishedSubscriber> publishedSubscribers_{PUBLISHED_TABLE_CAPACITY, memory_};
+    SeqlockTable<S1ap::MTmsi, S1ap::Imsi> publishedMTmsiToImsi_{PUBLISHED_TABLE_CAPACITY, memory_};
+
+    CgiPool cgiPool_;
+    std::vector<UeCounts> cellCounts_;
+    std::unordered_map<S1ap::EnodebID, UeCounts> enodebCounts_;
+
+    static constexpr std::size_t STATE_CHANGE_FEED_CAPACITY = 1 << 16;
+    StateChangeFeed stateChanges_{STATE_CHANGE_FEED_CAPACITY};
+
+    AdmissionConfig admission_{};
+    AdmissionStats admissionStats_{};
+    std::optional<TokenBucket> globalBucket_;
+    static constexpr std::size_t MAX_ENODEB_BUCKETS = 1 << 16;
+    std::unordered_map<S1ap::EnodebID, TokenBucket> enodebBuckets_;
+    std::uint64_t nextBucketSweepMs_ = 0;
+    bool overloaded_ = false;   // the event being handled found a bucket empty
+
+    bool tracing_ = false;
+    unsigned traceSampleOneIn_ = 0;
+    std::unordered_set<S1ap::Imsi> traceWatchlist_;
+    std::unordered_map<S1ap::Imsi, std::unique_ptr<EventTrace>> detachedTraces_;
+
+    // Rings stay put while their owner moves between the subscriber and
+    // detachedTraces_, so the pointer outlives a detach; DetachSubscriber()
+    // clears it when the ring goes with the record.
+    struct PendingTrace
+    {
+      EventTrace* trace = nullptr;
+      SubscriberState oldState;
+      SubscriberState newState;
+    };
+
+    PendingTrace pendingTrace_{};
 
     std::unordered_map<S1ap::Imsi, S1ap::Timestamp> imsiToIdentityRequestTimeout_;
     const S1ap::Timestamp IDENTITY_RESPONSE_TIMEOUT_MS = 5000;
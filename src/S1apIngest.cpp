@@ -0,0 +1,257 @@
+#include "S1apIngest.hpp"
+
+#include <cstring>
+#include <span>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace
+{
+  constexpr std::size_t CONTROL_SIZE = CMSG_SPACE(sizeof(std::uint32_t));
+}
+
+S1apIngest::S1apIngest(S1apDB& db)
+: S1apIngest(db, Config{}) {}
+
+S1apIngest::S1apIngest(S1apDB& db, const Config& config)
+: db_(db),
+  config_(config) {}
+
+S1apIngest::~S1apIngest()
+{
+  for (const auto& socket : sockets_)
+  {
+    ::close(socket->fd);
+
+    if (!socket->unixPath.empty())
+      ::unlink(socket->unixPath.c_str());
+  }
+}
+
+std::expected<std::size_t, S1apIngest::Error> S1apIngest::AddUdpSocket(const std::string& address, std::uint16_t port)
+{
+  sockaddr_in local{};
+  local.sin_family = AF_INET;
+  local.sin_port = htons(port);
+
+  if (::inet_pton(AF_INET, address.c_str(), &local.sin_addr) != 1)
+    return std::unexpected(Error::BadAddress);
+
+  const int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return std::unexpected(Error::SocketFailed);
+
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0)
+  {
+    ::close(fd);
+    return std::unexpected(Error::BindFailed);
+  }
+
+  return AddSocket(fd, {});
+}
+
+std::expected<std::size_t, S1apIngest::Error> S1apIngest::AddUnixSocket(const std::string& path)
+{
+  sockaddr_un local{};
+  local.sun_family = AF_UNIX;
+
+  if (path.empty() || path.size() >= sizeof(local.sun_path))
+    return std::unexpected(Error::BadAddress);
+
+  std::memcpy(local.sun_path, path.c_str(), path.size() + 1);
+
+  const int fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return std::unexpected(Error::SocketFailed);
+
+  ::unlink(path.c_str());
+
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0)
+  {
+    ::close(fd);
+    return std::unexpected(Error::BindFailed);
+  }
+
+  return AddSocket(fd, path);
+}
+
+std::expected<std::size_t, S1apIngest::Error> S1apIngest::AddSocket(int fd, std::string unixPath)
+{
+  const int on = 1;
+  ::setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &config_.receiveBufferBytes, sizeof(config_.receiveBufferBytes));
+
+  auto socket = std::make_unique<Socket>();
+  const std::size_t batch = config_.batchSize;
+
+  socket->fd = fd;
+  socket->unixPath = std::move(unixPath);
+  socket->buffers = std::make_unique<std::byte[]>(batch * config_.datagramSize);
+  socket->controls = std::make_unique<std::byte[]>(batch * CONTROL_SIZE);
+  socket->iovecs = std::make_unique<iovec[]>(batch);
+  socket->messages = std::make_unique<mmsghdr[]>(batch);
+
+  for (std::size_t i = 0; i < batch; ++i)
+  {
+    socket->iovecs[i].iov_base = socket->buffers.get() + i * config_.datagramSize;
+    socket->iovecs[i].iov_len = config_.datagramSize;
+
+    auto& header = socket->messages[i].msg_hdr;
+    header.msg_iov = &socket->iovecs[i];
+    header.msg_iovlen = 1;
+  }
+
+  sockets_.push_back(std::move(socket));
+  return sockets_.size() - 1;
+}
+
+std::uint16_t S1apIngest::GetLocalPort(std::size_t socket) const
+{
+  sockaddr_in local{};
+  socklen_t size = sizeof(local);
+
+  if (::getsockname(sockets_.at(socket)->fd, reinterpret_cast<sockaddr*>(&local), &size) != 0
+  ||  local.sin_family != AF_INET)
+    return 0;
+
+  return ntohs(local.sin_port);
+}
+
+const S1apIngest::SocketStats& S1apIngest::GetStats(std::size_t socket) const
+{
+  return sockets_.at(socket)->stats;
+}
+
+std::expected<std::size_t, S1apIngest::Error> S1apIngest::RunOnce(int timeoutMs)
+{
+  std::vector<pollfd> fds(sockets_.size());
+
+  for (std::size_t i = 0; i < sockets_.size(); ++i)
+    fds[i] = pollfd{.fd = sockets_[i]->fd, .events = POLLIN, .revents = 0};
+
+  const int ready = ::poll(fds.data(), fds.size(), timeoutMs);
+
+  if (ready < 0)
+    return errno == EINTR ? std::expected<std::size_t, Error>(0) : std::unexpected(Error::PollFailed);
+
+  std::size_t handled = 0;
+
+  for (std::size_t i = 0; i < sockets_.size(); ++i)
+  {
+    if (!(fds[i].revents & POLLIN))
+      continue;
+
+    auto drained = Drain(*sockets_[i]);
+    if (!drained.has_value())
+      return drained;
+
+    handled += drained.value();
+  }
+
+  return handled;
+}
+
+std::expected<void, S1apIngest::Error> S1apIngest::Run(const std::atomic<bool>& stop)
+{
+  while (!stop.load(std::memory_order_relaxed))
+  {
+    auto result = RunOnce(100);
+    if (!result.has_value())
+      return std::unexpected(result.error());
+  }
+
+  return {};
+}
+
+std::expected<std::size_t, S1apIngest::Error> S1apIngest::Drain(Socket& socket)
+{
+  const std::size_t batch = config_.batchSize;
+  std::size_t handled = 0;
+
+  // Whatever is left is picked up on the next poll, after the other sockets.
+  for (std::size_t round = 0; round < config_.maxBatchesPerPoll; ++round)
+  {
+    for (std::size_t i = 0; i < batch; ++i)
+    {
+      auto& header = socket.messages[i].msg_hdr;
+      header.msg_control = socket.controls.get() + i * CONTROL_SIZE;
+      header.msg_controllen = CONTROL_SIZE;
+      header.msg_flags = 0;
+    }
+
+    const int received = ::recvmmsg(socket.fd, socket.messages.get(), batch, MSG_DONTWAIT, nullptr);
+
+    if (received < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        return handled;
+
+      return std::unexpected(Error::ReceiveFailed);
+    }
+
+    for (int i = 0; i < received; ++i)
+    {
+      const auto& message = socket.messages[i];
+
+      for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message.msg_hdr); cmsg != nullptr;
+           cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&message.msg_hdr), cmsg))
+      {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+        {
+          std::uint32_t drops;
+          std::memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+          socket.stats.kernelDrops = drops;
+        }
+      }
+
+      ++socket.stats.datagrams;
+      socket.stats.bytes += message.msg_len;
+
+      if (message.msg_hdr.msg_flags & MSG_TRUNC)
+      {
+        ++socket.stats.truncatedDatagrams;
+        continue;
+      }
+
+      HandleDatagram(socket, static_cast<const std::byte*>(socket.iovecs[i].iov_base), message.msg_len);
+    }
+
+    for (const auto& event : events_)
+      if (!db_.Handle(event).has_value())
+        ++socket.stats.handleErrors;
+
+    socket.stats.events += events_.size();
+    handled += events_.size();
+    events_.clear();
+
+    if (static_cast<std::size_t>(received) < batch)
+      return handled;
+  }
+
+  return handled;
+}
+
+void S1apIngest::HandleDatagram(Socket& socket, const std::byte* data, std::size_t size)
+{
+  std::span<const std::byte> remaining(data, size);
+
+  while (!remaining.empty())
+  {
+    auto decoded = S1apCodec::Decode(remaining, events_);
+
+    if (!decoded.has_value())
+    {
+      ++socket.stats.malformedFrames;
+      return;
+    }
+
+    socket.stats.rejectedRecords += decoded->rejected;
+    remaining = remaining.subspan(decoded->frameSize);
+  }
+}
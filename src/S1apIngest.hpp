@@ -0,0 +1,98 @@
+#ifndef S1AP_INGEST_HPP
+#define S1AP_INGEST_HPP
+
+#include "S1apCodec.hpp"
+#include "S1apDB.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// Datagram front-end feeding S1apDB.
+//
+// Each datagram carries one or more S1apCodec event frames. Datagrams are
+// received with recvmmsg() into buffers allocated once per socket, decoded in
+// place and handed to S1apDB::Handle() batch by batch.
+class S1apIngest final
+{
+  public:
+    enum class Error
+    {
+      SocketFailed,
+      BindFailed,
+      BadAddress,
+      PollFailed,
+      ReceiveFailed,
+    };
+
+    struct Config
+    {
+      std::size_t batchSize = 64;
+      std::size_t maxBatchesPerPoll = 4;   // per socket, so one busy link cannot starve the rest
+      std::size_t datagramSize = 65536;
+      int receiveBufferBytes = 8 << 20;
+    };
+
+    struct SocketStats
+    {
+      std::uint64_t datagrams = 0;
+      std::uint64_t bytes = 0;
+      std::uint64_t events = 0;
+      std::uint64_t rejectedRecords = 0;
+      std::uint64_t malformedFrames = 0;
+      std::uint64_t truncatedDatagrams = 0;
+      std::uint64_t handleErrors = 0;
+      std::uint64_t kernelDrops = 0;    // SO_RXQ_OVFL, cumulative
+    };
+
+    explicit S1apIngest(S1apDB& db);
+    S1apIngest(S1apDB& db, const Config& config);
+    ~S1apIngest();
+
+    S1apIngest(const S1apIngest&) = delete;
+    S1apIngest& operator=(const S1apIngest&) = delete;
+
+    // Both return the index of the socket used by GetStats().
+    std::expected<std::size_t, Error> AddUdpSocket(const std::string& address, std::uint16_t port);
+    std::expected<std::size_t, Error> AddUnixSocket(const std::string& path);
+
+    // Port the UDP socket is bound to, useful after binding port 0.
+    std::uint16_t GetLocalPort(std::size_t socket) const;
+
+    // Wait up to timeoutMs for traffic and drain every ready socket once.
+    // Returns the number of events handed to S1apDB.
+    std::expected<std::size_t, Error> RunOnce(int timeoutMs);
+    std::expected<void, Error> Run(const std::atomic<bool>& stop);
+
+    const SocketStats& GetStats(std::size_t socket) const;
+
+  private:
+    struct Socket
+    {
+      int fd = -1;
+      std::string unixPath;
+      SocketStats stats;
+      std::unique_ptr<std::byte[]> buffers;
+      std::unique_ptr<std::byte[]> controls;
+      std::unique_ptr<iovec[]> iovecs;
+      std::unique_ptr<mmsghdr[]> messages;
+    };
+
+    std::expected<std::size_t, Error> AddSocket(int fd, std::string unixPath);
+    std::expected<std::size_t, Error> Drain(Socket& socket);
+    void HandleDatagram(Socket& socket, const std::byte* data, std::size_t size);
+
+    S1apDB& db_;
+    Config config_;
+    std::vector<std::unique_ptr<Socket>> sockets_;
+    std::vector<Event> events_;
+};
+
+#endif // S1AP_INGEST_HPP
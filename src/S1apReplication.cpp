@@ -0,0 +1,551 @@
+#include "S1apReplication.hpp"
+
+#include "S1apCodec.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <span>
+#include <thread>
+#include <variant>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+  using S1apReplication::Endpoint;
+  using S1apReplication::Error;
+
+  constexpr std::uint32_t MESSAGE_MAGIC = 0x50523153; // "S1RP"
+  constexpr std::size_t MESSAGE_HEADER_SIZE = 24;
+
+  enum class MessageType : std::uint8_t
+  {
+    Snapshot = 1,
+    Events   = 2,
+    Resync   = 3,
+  };
+
+  constexpr int RECONNECT_ATTEMPTS = 100;
+  constexpr auto RECONNECT_DELAY = std::chrono::milliseconds(10);
+
+  struct MessageHeader
+  {
+    MessageType type;
+    std::uint64_t sequence;
+    std::uint64_t length;
+  };
+
+  std::array<std::byte, MESSAGE_HEADER_SIZE> EncodeHeader(const MessageHeader& header)
+  {
+    std::array<std::byte, MESSAGE_HEADER_SIZE> bytes{};
+
+    std::memcpy(bytes.data(), &MESSAGE_MAGIC, sizeof(MESSAGE_MAGIC));
+    bytes[4] = static_cast<std::byte>(header.type);
+    std::memcpy(bytes.data() + 8, &header.sequence, sizeof(header.sequence));
+    std::memcpy(bytes.data() + 16, &header.length, sizeof(header.length));
+
+    return bytes;
+  }
+
+  bool SendAll(int fd, std::span<const std::byte> data)
+  {
+    while (!data.empty())
+    {
+      const ssize_t sent = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+
+      if (sent < 0)
+      {
+        if (errno == EINTR)
+          continue;
+
+        return false;
+      }
+
+      data = data.subspan(static_cast<std::size_t>(sent));
+    }
+
+    return true;
+  }
+
+  bool SendMessage(int fd, MessageType type, std::uint64_t sequence, std::span<const std::byte> payload)
+  {
+    const auto header = EncodeHeader(MessageHeader{type, sequence, payload.size()});
+    return SendAll(fd, header) && SendAll(fd, payload);
+  }
+
+  enum class ReadResult
+  {
+    Done,
+    Closed,
+    Stopped,
+    Failed,
+  };
+
+  // The socket has a receive timeout, so a quiet primary still lets us
+  // notice stop.
+  ReadResult ReadAll(int fd, std::span<std::byte> data, const std::atomic<bool>& stop)
+  {
+    while (!data.empty())
+    {
+      if (stop.load(std::memory_order_relaxed))
+        return ReadResult::Stopped;
+
+      const ssize_t received = ::recv(fd, data.data(), data.size(), 0);
+
+      if (received == 0)
+        return ReadResult::Closed;
+
+      if (received < 0)
+      {
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+          continue;
+
+        return errno == ECONNRESET ? ReadResult::Closed : ReadResult::Failed;
+      }
+
+      data = data.subspan(static_cast<std::size_t>(received));
+    }
+
+    return ReadResult::Done;
+  }
+
+  std::expected<int, Error> OpenSocket(const Endpoint& endpoint, bool listen)
+  {
+    sockaddr_storage address{};
+    socklen_t addressSize = 0;
+
+    if (!endpoint.unixPath.empty())
+    {
+      auto& local = reinterpret_cast<sockaddr_un&>(address);
+      local.sun_family = AF_UNIX;
+
+      if (endpoint.unixPath.size() >= sizeof(local.sun_path))
+        return std::unexpected(Error::BadAddress);
+
+      std::memcpy(local.sun_path, endpoint.unixPath.c_str(), endpoint.unixPath.size() + 1);
+      addressSize = sizeof(sockaddr_un);
+    }
+    else
+    {
+      auto& inet = reinterpret_cast<sockaddr_in&>(address);
+      inet.sin_family = AF_INET;
+      inet.sin_port = htons(endpoint.port);
+
+      if (::inet_pton(AF_INET, endpoint.host.c_str(), &inet.sin_addr) != 1)
+        return std::unexpected(Error::BadAddress);
+
+      addressSize = sizeof(sockaddr_in);
+    }
+
+    const int fd = ::socket(address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+      return std::unexpected(Error::SocketFailed);
+
+    const int on = 1;
+    if (address.ss_family == AF_INET)
+    {
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+
+    if (listen)
+    {
+      if (!endpoint.unixPath.empty())
+        ::unlink(endpoint.unixPath.c_str());
+
+      if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), addressSize) != 0 || ::listen(fd, 1) != 0)
+      {
+        ::close(fd);
+        return std::unexpected(Error::BindFailed);
+      }
+    }
+    else if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), addressSize) != 0)
+    {
+      ::close(fd);
+      return std::unexpected(Error::ConnectFailed);
+    }
+
+    return fd;
+  }
+}
+
+std::expected<Endpoint, Error> Endpoint::Parse(const std::string& address)
+{
+  Endpoint endpoint{};
+
+  if (address.starts_with("unix:"))
+  {
+    endpoint.unixPath = address.substr(5);
+    if (endpoint.unixPath.empty())
+      return std::unexpected(Error::BadAddress);
+
+    return endpoint;
+  }
+
+  const auto colon = address.rfind(':');
+  if (colon == std::string::npos || colon + 1 == address.size())
+    return std::unexpected(Error::BadAddress);
+
+  endpoint.host = address.substr(0, colon);
+
+  const char* first = address.data() + colon + 1;
+  const char* last = address.data() + address.size();
+  const auto [end, error] = std::from_chars(first, last, endpoint.port);
+
+  if (error != std::errc{} || end != last)
+    return std::unexpected(Error::BadAddress);
+
+  return endpoint;
+}
+
+S1apReplicaPrimary::S1apReplicaPrimary(S1apDB& db)
+: S1apReplicaPrimary(db, Config{}) {}
+
+S1apReplicaPrimary::S1apReplicaPrimary(S1apDB& db, const Config& config)
+: db_(db),
+  config_(config) {}
+
+S1apReplicaPrimary::~S1apReplicaPrimary()
+{
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+
+  wakeSender_.notify_all();
+
+  if (sender_.joinable())
+    sender_.join();
+
+  if (listenFd_ >= 0)
+    ::close(listenFd_);
+
+  if (!unixPath_.empty())
+    ::unlink(unixPath_.c_str());
+}
+
+std::expected<void, S1apReplicaPrimary::Error> S1apReplicaPrimary::Listen(const S1apReplication::Endpoint& endpoint)
+{
+  auto fd = OpenSocket(endpoint, true);
+  if (!fd.has_value())
+    return std::unexpected(fd.error());
+
+  listenFd_ = fd.value();
+  unixPath_ = endpoint.unixPath;
+  sender_ = std::thread([this] { SenderLoop(); });
+
+  return {};
+}
+
+std::uint16_t S1apReplicaPrimary::GetLocalPort() const
+{
+  sockaddr_in local{};
+  socklen_t size = sizeof(local);
+
+  if (::getsockname(listenFd_, reinterpret_cast<sockaddr*>(&local), &size) != 0 || local.sin_family != AF_INET)
+    return 0;
+
+  return ntohs(local.sin_port);
+}
+
+S1apDB::HandleOut S1apReplicaPrimary::Handle(const Event& event)
+{
+  auto out = db_.Handle(event);
+
+  // Events that failed Verify() or were shed never touched the state;
+  // everything else is forwarded, so the standby runs through exactly the
+  // same transitions.
+  const bool replicate = out.has_value()
+                      || (std::holds_alternative<S1apDB::Error>(out.error())
+                          && std::get<S1apDB::Error>(out.error()) != S1apDB::Error::Overloaded);
+
+  if (replicate)
+  {
+    const auto sequence = sequence_.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    if (streaming_.load(std::memory_order_relaxed))
+    {
+      std::lock_guard lock(mutex_);
+
+      if (pending_.size() >= config_.maxBacklog)
+        overflow_ = true;
+      else
+      {
+        if (pending_.empty())
+          pendingFirst_ = sequence;
+
+        pending_.push_back(event);
+      }
+
+      if (overflow_ || pending_.size() >= config_.maxBatch)
+        wakeSender_.notify_one();
+    }
+  }
+
+  Service();
+  return out;
+}
+
+void S1apReplicaPrimary::Service()
+{
+  if (!snapshotRequested_.load(std::memory_order_relaxed) || !snapshotRequested_.exchange(false))
+    return;
+
+  auto bytes = db_.SaveSnapshot();
+
+  {
+    std::lock_guard lock(mutex_);
+
+    pending_.clear();
+    overflow_ = false;
+    snapshot_ = Snapshot{sequence_.load(std::memory_order_relaxed), std::move(bytes)};
+    streaming_ = true;
+  }
+
+  wakeSender_.notify_one();
+}
+
+std::uint64_t S1apReplicaPrimary::GetSequence() const { return sequence_.load(); }
+std::uint64_t S1apReplicaPrimary::GetResyncCount() const { return resyncs_.load(); }
+bool S1apReplicaPrimary::HasStandby() const { return streaming_.load(); }
+
+void S1apReplicaPrimary::SenderLoop()
+{
+  while (!stop_.load())
+  {
+    pollfd listening{.fd = listenFd_, .events = POLLIN, .revents = 0};
+
+    if (::poll(&listening, 1, 100) <= 0)
+      continue;
+
+    const int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+      continue;
+
+    const int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    StreamTo(fd);
+    ::close(fd);
+
+    streaming_ = false;
+
+    std::lock_guard lock(mutex_);
+    pending_.clear();
+    overflow_ = false;
+  }
+}
+
+void S1apReplicaPrimary::StreamTo(int fd)
+{
+  Snapshot snapshot;
+
+  {
+    std::unique_lock lock(mutex_);
+
+    snapshot_.reset();
+    snapshotRequested_ = true;
+
+    wakeSender_.wait(lock, [this] { return stop_.load() || snapshot_.has_value(); });
+    if (stop_.load())
+      return;
+
+    snapshot = std::move(snapshot_).value();
+    snapshot_.reset();
+  }
+
+  if (!SendMessage(fd, MessageType::Snapshot, snapshot.sequence, snapshot.bytes))
+    return;
+
+  ++resyncs_;
+
+  std::vector<Event> batch;
+  std::vector<std::byte> frame;
+
+  for (;;)
+  {
+    std::uint64_t first;
+
+    {
+      std::unique_lock lock(mutex_);
+
+      wakeSender_.wait_for(lock, config_.flushInterval, [this] {
+        return stop_.load() || overflow_ || pending_.size() >= config_.maxBatch;
+      });
+
+      if (stop_.load())
+        return;
+
+      // Closing alone would look like a lost primary to the standby.
+      if (overflow_)
+      {
+        lock.unlock();
+        SendMessage(fd, MessageType::Resync, 0, {});
+        return;
+      }
+
+      batch.swap(pending_);
+      first = pendingFirst_;
+    }
+
+    if (batch.empty())
+      continue;
+
+    frame.clear();
+    const bool sent = S1apCodec::Encode(std::span<const Event>(batch), frame).has_value()
+                   && SendMessage(fd, MessageType::Events, first, frame);
+
+    batch.clear();
+
+    if (!sent)
+      return;
+  }
+}
+
+S1apReplicaStandby::S1apReplicaStandby(S1apDB& db)
+: db_(db) {}
+
+S1apReplicaStandby::~S1apReplicaStandby()
+{
+  if (fd_ >= 0)
+    ::close(fd_);
+}
+
+std::expected<void, S1apReplicaStandby::Error> S1apReplicaStandby::Connect(const S1apReplication::Endpoint& endpoint)
+{
+  auto fd = OpenSocket(endpoint, false);
+  if (!fd.has_value())
+    return std::unexpected(fd.error());
+
+  timeval timeout{.tv_sec = 0, .tv_usec = 100000};
+  ::setsockopt(fd.value(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  fd_ = fd.value();
+  endpoint_ = endpoint;
+  return {};
+}
+
+std::expected<void, S1apReplicaStandby::Error> S1apReplicaStandby::Reconnect(const std::atomic<bool>& stop)
+{
+  ::close(fd_);
+  fd_ = -1;
+
+  for (int attempt = 0; attempt < RECONNECT_ATTEMPTS && !stop.load(); ++attempt)
+  {
+    if (Connect(endpoint_).has_value())
+    {
+      ++resyncs_;
+      return {};
+    }
+
+    std::this_thread::sleep_for(RECONNECT_DELAY);
+  }
+
+  return std::unexpected(Error::ResyncFailed);
+}
+
+std::expected<void, S1apReplicaStandby::Error> S1apReplicaStandby::Run(const std::atomic<bool>& stop)
+{
+  std::array<std::byte, MESSAGE_HEADER_SIZE> headerBytes;
+  std::vector<std::byte> payload;
+  std::vector<Event> events;
+
+  // Only a standby holding a snapshot and its tail may take over.
+  bool synced = false;
+
+  for (;;)
+  {
+    switch (ReadAll(fd_, headerBytes, stop))
+    {
+      case ReadResult::Done:
+        break;
+
+      case ReadResult::Closed:
+        if (!synced)
+          return std::unexpected(Error::ResyncFailed);
+
+        return {};
+
+      case ReadResult::Stopped:
+        return {};
+
+      case ReadResult::Failed:
+        return std::unexpected(Error::ProtocolError);
+    }
+
+    std::uint32_t magic;
+    MessageHeader header{};
+
+    std::memcpy(&magic, headerBytes.data(), sizeof(magic));
+    header.type = static_cast<MessageType>(headerBytes[4]);
+    std::memcpy(&header.sequence, headerBytes.data() + 8, sizeof(header.sequence));
+    std::memcpy(&header.length, headerBytes.data() + 16, sizeof(header.length));
+
+    if (magic != MESSAGE_MAGIC)
+      return std::unexpected(Error::ProtocolError);
+
+    payload.resize(header.length);
+    if (ReadAll(fd_, payload, stop) != ReadResult::Done)
+      return stop.load() ? std::expected<void, Error>{} : std::unexpected(Error::ProtocolError);
+
+    switch (header.type)
+    {
+      case MessageType::Snapshot:
+        if (!db_.LoadSnapshot(payload).has_value())
+          return std::unexpected(Error::BadSnapshot);
+
+        applied_ = header.sequence;
+        synced = true;
+        break;
+
+      case MessageType::Events:
+      {
+        if (header.sequence != applied_.load() + 1)
+          return std::unexpected(Error::SequenceGap);
+
+        events.clear();
+        auto decoded = S1apCodec::Decode(payload, events);
+
+        if (!decoded.has_value() || decoded->rejected != 0)
+          return std::unexpected(Error::ProtocolError);
+
+        for (const auto& event : events)
+          db_.Handle(event);
+
+        applied_ = header.sequence + events.size() - 1;
+        break;
+      }
+
+      case MessageType::Resync:
+      {
+        synced = false;
+
+        auto reconnected = Reconnect(stop);
+        if (!reconnected.has_value())
+          return stop.load() ? std::expected<void, Error>{} : reconnected;
+
+        break;
+      }
+
+      default:
+        return std::unexpected(Error::ProtocolError);
+    }
+  }
+}
+
+std::uint64_t S1apReplicaStandby::GetAppliedSequence() const
+{
+  return applied_.load();
+}
+
+std::uint64_t S1apReplicaStandby::GetResyncCount() const
+{
+  return resyncs_.load();
+}
@@ -0,0 +1,158 @@
+#ifndef S1AP_REPLICATION_HPP
+#define S1AP_REPLICATION_HPP
+
+#include "S1apDB.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Hot-standby replication of S1apDB over a TCP or Unix stream socket.
+//
+// The primary forwards every event that passed S1apDB validation. Handle() is
+// deterministic, so replaying the same events on the standby reproduces the
+// same state, M-TMSI allocation included. A standby that connects first gets
+// a snapshot taken by the writer thread, then the log tail after it. The
+// writer only appends to an in-memory batch; a sender thread ships batches
+// every flushInterval or maxBatch events, which bounds what a takeover loses.
+//
+// Messages: u32 magic | u8 type | u8[3] reserved | u64 sequence | u64 length
+// followed by length payload bytes. A snapshot carries the sequence of the
+// last event it includes, an event batch the sequence of its first event and
+// one S1apCodec frame. A resync message, with no payload, tells a standby the
+// primary dropped it and is still up: its state is stale, it has to connect
+// again and reload a snapshot rather than take over.
+namespace S1apReplication
+{
+  enum class Error
+  {
+    SocketFailed,
+    BindFailed,
+    ConnectFailed,
+    BadAddress,
+    ProtocolError,
+    SequenceGap,
+    BadSnapshot,
+    ResyncFailed,
+  };
+
+  // "unix:/path/to/socket" or "HOST:PORT".
+  struct Endpoint
+  {
+    static std::expected<Endpoint, Error> Parse(const std::string& address);
+
+    std::string unixPath;
+    std::string host;
+    std::uint16_t port = 0;
+  };
+}
+
+class S1apReplicaPrimary final
+{
+  public:
+    using Error = S1apReplication::Error;
+
+    struct Config
+    {
+      std::chrono::milliseconds flushInterval{5};
+      std::size_t maxBatch = 1024;
+      std::size_t maxBacklog = 1 << 20;   // events; a slower standby is resynced
+    };
+
+    explicit S1apReplicaPrimary(S1apDB& db);
+    S1apReplicaPrimary(S1apDB& db, const Config& config);
+    ~S1apReplicaPrimary();
+
+    S1apReplicaPrimary(const S1apReplicaPrimary&) = delete;
+    S1apReplicaPrimary& operator=(const S1apReplicaPrimary&) = delete;
+
+    std::expected<void, Error> Listen(const S1apReplication::Endpoint& endpoint);
+    std::uint16_t GetLocalPort() const;
+
+    // Writer thread only. Handles the event and queues it for the standby
+    // unless it failed validation.
+    S1apDB::HandleOut Handle(const Event& event);
+
+    // Writer thread only. Takes a snapshot a newly connected standby is
+    // waiting for; call it when no events arrive for a while.
+    void Service();
+
+    // Sequence number of the last accepted event.
+    std::uint64_t GetSequence() const;
+    std::uint64_t GetResyncCount() const;
+    bool HasStandby() const;
+
+  private:
+    struct Snapshot
+    {
+      std::uint64_t sequence;
+      std::vector<std::byte> bytes;
+    };
+
+    void SenderLoop();
+    void StreamTo(int fd);
+
+    S1apDB& db_;
+    Config config_;
+
+    int listenFd_ = -1;
+    std::string unixPath_;
+    std::thread sender_;
+
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> streaming_{false};
+    std::atomic<bool> snapshotRequested_{false};
+    std::atomic<std::uint64_t> sequence_{0};
+    std::atomic<std::uint64_t> resyncs_{0};
+
+    std::mutex mutex_;
+    std::condition_variable wakeSender_;
+    std::vector<Event> pending_;
+    std::uint64_t pendingFirst_ = 0;
+    bool overflow_ = false;
+    std::optional<Snapshot> snapshot_;
+};
+
+class S1apReplicaStandby final
+{
+  public:
+    using Error = S1apReplication::Error;
+
+    explicit S1apReplicaStandby(S1apDB& db);
+    ~S1apReplicaStandby();
+
+    S1apReplicaStandby(const S1apReplicaStandby&) = delete;
+    S1apReplicaStandby& operator=(const S1apReplicaStandby&) = delete;
+
+    std::expected<void, Error> Connect(const S1apReplication::Endpoint& endpoint);
+
+    // Applies the replication stream until the primary goes away, which is
+    // a normal return: the S1apDB is then ready to take over. When the
+    // primary drops this standby for lagging, it reconnects and reloads a
+    // snapshot; if that fails it returns ResyncFailed, since its state is
+    // stale. Returns early when stop is set.
+    std::expected<void, Error> Run(const std::atomic<bool>& stop);
+
+    // Sequence number of the last applied event. Any thread.
+    std::uint64_t GetAppliedSequence() const;
+    std::uint64_t GetResyncCount() const;
+
+  private:
+    std::expected<void, Error> Reconnect(const std::atomic<bool>& stop);
+
+    S1apDB& db_;
+    S1apReplication::Endpoint endpoint_{};
+    int fd_ = -1;
+    std::atomic<std::uint64_t> applied_{0};
+    std::atomic<std::uint64_t> resyncs_{0};
+};
+
+#endif // S1AP_REPLICATION_HPP
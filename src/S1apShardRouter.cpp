@@ -0,0 +1,47 @@
+#include "S1apShardRouter.hpp"
+
+#include <bit>
+
+S1apShardRouter::S1apShardRouter(unsigned shardCount)
+: shardCount_(shardCount == 0 ? 1 : shardCount),
+  shardBits_(GetShardBits(shardCount_)) {}
+
+unsigned S1apShardRouter::GetShardBits(unsigned shardCount)
+{
+  return shardCount <= 1 ? 0 : std::bit_width(shardCount - 1);
+}
+
+std::optional<unsigned> S1apShardRouter::Route(const Event& event) const
+{
+  if (event.GetImsi().has_value())
+    return ShardOfImsi(event.GetImsi().value());
+
+  if (event.GetMTmsi().has_value())
+  {
+    const auto shard = ShardOfMTmsi(event.GetMTmsi().value());
+    if (shard >= shardCount_)
+      return std::nullopt;
+
+    return shard;
+  }
+
+  if (shardCount_ == 1)
+    return 0;
+
+  return std::nullopt;
+}
+
+unsigned S1apShardRouter::ShardOfImsi(S1ap::Imsi imsi) const
+{
+  return static_cast<unsigned>(imsi % shardCount_);
+}
+
+unsigned S1apShardRouter::ShardOfMTmsi(S1ap::MTmsi mTmsi) const
+{
+  if (shardBits_ == 0)
+    return 0;
+
+  return mTmsi >> (32 - shardBits_);
+}
+
+unsigned S1apShardRouter::GetShardCount() const { return shardCount_; }
@@ -0,0 +1,36 @@
+#ifndef S1AP_SHARD_ROUTER_HPP
+#define S1AP_SHARD_ROUTER_HPP
+
+#include "S1apDB.hpp"
+
+#include <optional>
+
+// Picks the S1apDB shard that owns an event when subscribers are partitioned
+// by IMSI. Events carrying an IMSI go to ShardOfImsi(); events carrying only
+// an M-TMSI are routed by the shard index the owner encoded into it. Neither
+// needs shared state or locking.
+//
+// Events identified only by eNodeB/MME IDs have no routable key: Route()
+// returns nullopt and the caller has to offer them to every shard, all but
+// the owner answer SubscriberNotFound.
+class S1apShardRouter final
+{
+  public:
+    explicit S1apShardRouter(unsigned shardCount);
+
+    std::optional<unsigned> Route(const Event& event) const;
+
+    unsigned ShardOfImsi(S1ap::Imsi imsi) const;
+    unsigned ShardOfMTmsi(S1ap::MTmsi mTmsi) const;
+
+    unsigned GetShardCount() const;
+
+    // Number of top M-TMSI bits reserved for the shard index.
+    static unsigned GetShardBits(unsigned shardCount);
+
+  private:
+    unsigned shardCount_;
+    unsigned shardBits_;
+};
+
+#endif // S1AP_SHARD_ROUTER_HPP
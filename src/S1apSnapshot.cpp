@@ -0,0 +1,323 @@
+#include "S1apDB.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+// Snapshot layout, little-endian:
+//
+//   u32 magic | u16 version | u16 reserved | u32 nextMTmsi
+//   u32 cellCount,       per cell:       u8 size, size bytes (in CellID order)
+//   u64 subscriberCount, per subscriber: u64 imsi, u64 lastEventTimestamp,
+//                                        u32 mTmsi, u32 enodebID, u32 mmeID,
+//                                        u32 cellID, u8 presence, u8 state,
+//                                        u8 lastEventType
+//   u64 mTmsiCount,      per entry:      u32 mTmsi, u64 imsi
+//   u64 enodebCount,     per entry:      u32 enodebID, u64 imsi
+//   u64 timeoutCount,    per timeout:    u64 imsi, u64 timestamp
+//
+// The M-TMSI and eNodeB indexes are stored as they are rather than rebuilt
+// from the subscribers, so a restored instance answers exactly like the
+// original one. Every section is sorted by its key; a repeated or unordered
+// key rejects the snapshot.
+
+namespace
+{
+  constexpr std::uint32_t SNAPSHOT_MAGIC = 0x4e533153; // "S1SN"
+  constexpr std::uint16_t SNAPSHOT_VERSION = 1;
+
+  enum SnapshotPresence : std::uint8_t
+  {
+    HAS_MTMSI    = 1 << 0,
+    HAS_ENODEBID = 1 << 1,
+    HAS_MMEID    = 1 << 2,
+    HAS_CELLID   = 1 << 3,
+  };
+
+  class SnapshotWriter
+  {
+    public:
+      explicit SnapshotWriter(std::vector<std::byte>& out) : out_(out) {}
+
+      template <typename T>
+      void Put(T value)
+      {
+        if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1)
+          value = std::byteswap(value);
+
+        const auto offset = out_.size();
+        out_.resize(offset + sizeof(T));
+        std::memcpy(out_.data() + offset, &value, sizeof(T));
+      }
+
+      void PutBytes(std::span<const unsigned char> bytes)
+      {
+        const auto* data = reinterpret_cast<const std::byte*>(bytes.data());
+        out_.insert(out_.end(), data, data + bytes.size());
+      }
+
+    private:
+      std::vector<std::byte>& out_;
+  };
+
+  class SnapshotReader
+  {
+    public:
+      explicit SnapshotReader(std::span<const std::byte> in) : in_(in) {}
+
+      template <typename T>
+      bool Get(T& value)
+      {
+        if (in_.size() < sizeof(T))
+          return false;
+
+        std::memcpy(&value, in_.data(), sizeof(T));
+        in_ = in_.subspan(sizeof(T));
+
+        if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1)
+          value = std::byteswap(value);
+
+        return true;
+      }
+
+      bool GetBytes(std::size_t size, std::span<const unsigned char>& bytes)
+      {
+        if (in_.size() < size)
+          return false;
+
+        bytes = std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(in_.data()), size);
+        in_ = in_.subspan(size);
+        return true;
+      }
+
+      bool AtEnd() const { return in_.empty(); }
+
+    private:
+      std::span<const std::byte> in_;
+  };
+}
+
+std::vector<std::byte> S1apDB::SaveSnapshot() const
+{
+  std::vector<std::byte> out;
+  SnapshotWriter writer(out);
+
+  writer.Put<std::uint32_t>(SNAPSHOT_MAGIC);
+  writer.Put<std::uint16_t>(SNAPSHOT_VERSION);
+  writer.Put<std::uint16_t>(0);
+  writer.Put<std::uint32_t>(nextMTmsi_);
+
+  writer.Put<std::uint32_t>(static_cast<std::uint32_t>(cgiPool_.Size()));
+  for (S1ap::CellID cellID = 0; cellID < cgiPool_.Size(); ++cellID)
+  {
+    const auto cgi = cgiPool_.GetCgi(cellID);
+    writer.Put<std::uint8_t>(static_cast<std::uint8_t>(cgi.size()));
+    writer.PutBytes(cgi);
+  }
+
+  std::vector<const Subscriber*> subscribers;
+  subscribers.reserve(imsiToSubscriber.size());
+  for (const auto& [imsi, subscriber] : imsiToSubscriber)
+    subscribers.push_back(&subscriber);
+
+  std::ranges::sort(subscribers, {}, [](const Subscriber* subscriber) { return subscriber->GetImsi().value(); });
+
+  writer.Put<std::uint64_t>(subscribers.size());
+  for (const Subscriber* subscriber : subscribers)
+  {
+    std::uint8_t presence = 0;
+
+    if (subscriber->GetMTmsi().has_value())
+      presence |= HAS_MTMSI;
+    if (subscriber->GetEnodebID().has_value())
+      presence |= HAS_ENODEBID;
+    if (subscriber->GetMmeID().has_value())
+      presence |= HAS_MMEID;
+    if (subscriber->GetCellID().has_value())
+      presence |= HAS_CELLID;
+
+    writer.Put<std::uint64_t>(subscriber->GetImsi().value());
+    writer.Put<std::uint64_t>(subscriber->GetLastEventTimestamp());
+    writer.Put<std::uint32_t>(subscriber->GetMTmsi().value_or(0));
+    writer.Put<std::uint32_t>(subscriber->GetEnodebID().value_or(0));
+    writer.Put<std::uint32_t>(subscriber->GetMmeID().value_or(0));
+    writer.Put<std::uint32_t>(subscriber->GetCellID().value_or(0));
+    writer.Put<std::uint8_t>(presence);
+    writer.Put<std::uint8_t>(static_cast<std::uint8_t>(subscriber->GetState()));
+    writer.Put<std::uint8_t>(static_cast<std::uint8_t>(subscriber->GetLastEventType()));
+  }
+
+  std::vector<std::pair<S1ap::MTmsi, S1ap::Imsi>> mTmsis(mTmsiToImsi.begin(), mTmsiToImsi.end());
+  std::ranges::sort(mTmsis);
+
+  writer.Put<std::uint64_t>(mTmsis.size());
+  for (const auto& [mTmsi, imsi] : mTmsis)
+  {
+    writer.Put<std::uint32_t>(mTmsi);
+    writer.Put<std::uint64_t>(imsi);
+  }
+
+  std::vector<std::pair<S1ap::EnodebID, S1ap::Imsi>> enodebIDs(enodebIDToImsi.begin(), enodebIDToImsi.end());
+  std::ranges::sort(enodebIDs);
+
+  writer.Put<std::uint64_t>(enodebIDs.size());
+  for (const auto& [enodebID, imsi] : enodebIDs)
+  {
+    writer.Put<std::uint32_t>(enodebID);
+    writer.Put<std::uint64_t>(imsi);
+  }
+
+  std::vector<std::pair<S1ap::Imsi, S1ap::Timestamp>> timeouts(imsiToIdentityRequestTimeout_.begin(),
+                                                               imsiToIdentityRequestTimeout_.end());
+  std::ranges::sort(timeouts);
+
+  writer.Put<std::uint64_t>(timeouts.size());
+  for (const auto& [imsi, timestamp] : timeouts)
+  {
+    writer.Put<std::uint64_t>(imsi);
+    writer.Put<std::uint64_t>(timestamp);
+  }
+
+  return out;
+}
+
+std::expected<void, S1apDB::Error> S1apDB::LoadSnapshot(std::span<const std::byte> snapshot)
+{
+  SnapshotReader reader(snapshot);
+
+  std::uint32_t magic, nextMTmsi, cellCount;
+  std::uint16_t version, reserved;
+
+  if (!reader.Get(magic) || !reader.Get(version) || !reader.Get(reserved) || !reader.Get(nextMTmsi)
+  ||  magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION
+  ||  !reader.Get(cellCount))
+    return std::unexpected(Error::BadSnapshot);
+
+  CgiPool cgiPool;
+
+  for (std::uint32_t i = 0; i < cellCount; ++i)
+  {
+    std::uint8_t size;
+    std::span<const unsigned char> cgi;
+
+    if (!reader.Get(size) || size > Event::MAX_CGI_SIZE || !reader.GetBytes(size, cgi) || cgiPool.Intern(cgi) != i)
+      return std::unexpected(Error::BadSnapshot);
+  }
+
+  std::uint64_t subscriberCount;
+  if (!reader.Get(subscriberCount))
+    return std::unexpected(Error::BadSnapshot);
+
+  std::vector<Subscriber> subscribers;
+  std::uint64_t lastImsi = 0;
+
+  for (std::uint64_t i = 0; i < subscriberCount; ++i)
+  {
+    std::uint64_t imsi, lastEventTimestamp;
+    std::uint32_t mTmsi, enodebID, mmeID, cellID;
+    std::uint8_t presence, state, lastEventType;
+
+    if (!reader.Get(imsi) || !reader.Get(lastEventTimestamp)
+    ||  !reader.Get(mTmsi) || !reader.Get(enodebID) || !reader.Get(mmeID) || !reader.Get(cellID)
+    ||  !reader.Get(presence) || !reader.Get(state) || !reader.Get(lastEventType)
+    ||  state > static_cast<std::uint8_t>(SubscriberState::RELEASING)
+    ||  lastEventType > static_cast<std::uint8_t>(Event::Type::UEContextReleaseResponse)
+    ||  ((presence & HAS_CELLID) && cellID >= cellCount)
+    ||  (i != 0 && imsi <= lastImsi))
+      return std::unexpected(Error::BadSnapshot);
+
+    lastImsi = imsi;
+    Subscriber& subscriber = subscribers.emplace_back();
+
+    subscriber.SetImsi(imsi);
+    subscriber.SetState(static_cast<SubscriberState>(state));
+    subscriber.SetLastEvent(static_cast<Event::Type>(lastEventType), lastEventTimestamp);
+
+    if (presence & HAS_MTMSI)
+      subscriber.SetMTmsi(mTmsi);
+    if (presence & HAS_ENODEBID)
+      subscriber.SetEnodebID(enodebID);
+    if (presence & HAS_MMEID)
+      subscriber.SetMmeID(mmeID);
+    if (presence & HAS_CELLID)
+      subscriber.SetCellID(cellID);
+  }
+
+  std::pmr::unordered_map<S1ap::MTmsi, S1ap::Imsi> mTmsis{memory_};
+  std::pmr::unordered_map<S1ap::EnodebID, S1ap::Imsi> enodebIDs{memory_};
+
+  for (auto* index : {&mTmsis, &enodebIDs})
+  {
+    std::uint64_t count;
+    if (!reader.Get(count))
+      return std::unexpected(Error::BadSnapshot);
+
+    std::uint32_t lastKey = 0;
+
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+      std::uint32_t key;
+      std::uint64_t imsi;
+      if (!reader.Get(key) || !reader.Get(imsi) || (i != 0 && key <= lastKey))
+        return std::unexpected(Error::BadSnapshot);
+
+      lastKey = key;
+      (*index)[key] = imsi;
+    }
+  }
+
+  std::uint64_t timeoutCount;
+  if (!reader.Get(timeoutCount))
+    return std::unexpected(Error::BadSnapshot);
+
+  std::unordered_map<S1ap::Imsi, S1ap::Timestamp> timeouts;
+  lastImsi = 0;
+
+  for (std::uint64_t i = 0; i < timeoutCount; ++i)
+  {
+    std::uint64_t imsi, timestamp;
+    if (!reader.Get(imsi) || !reader.Get(timestamp) || (i != 0 && imsi <= lastImsi))
+      return std::unexpected(Error::BadSnapshot);
+
+    lastImsi = imsi;
+    timeouts[imsi] = timestamp;
+  }
+
+  if (!reader.AtEnd())
+    return std::unexpected(Error::BadSnapshot);
+
+  Clear();
+
+  nextMTmsi_ = nextMTmsi;
+  cgiPool_ = std::move(cgiPool);
+  mTmsiToImsi = std::move(mTmsis);
+  enodebIDToImsi = std::move(enodebIDs);
+  imsiToIdentityRequestTimeout_ = std::move(timeouts);
+
+  for (auto& loaded : subscribers)
+  {
+    auto& subscriber = imsiToSubscriber[loaded.GetImsi().value()] = std::move(loaded);
+
+    StartTrace(subscriber);
+    PublishSubscriber(subscriber);
+  }
+
+  return {};
+}
+
+void S1apDB::Clear()
+{
+  for (auto& [imsi, subscriber] : imsiToSubscriber)
+    UnpublishSubscriber(subscriber);
+
+  imsiToSubscriber.clear();
+  mTmsiToImsi.clear();
+  enodebIDToImsi.clear();
+  mmeIDToImsi.clear();
+  imsiToIdentityRequestTimeout_.clear();
+  detachedTraces_.clear();
+
+  cgiPool_ = CgiPool{};
+  cellCounts_.clear();
+  enodebCounts_.clear();
+}
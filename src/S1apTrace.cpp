@@ -0,0 +1,117 @@
+#include "S1apDB.hpp"
+
+#include <cstdint>
+
+namespace
+{
+  // Spreads consecutive IMSIs, so sampling does not follow number ranges.
+  std::uint64_t MixImsi(std::uint64_t imsi)
+  {
+    imsi ^= imsi >> 33;
+    imsi *= 0xff51afd7ed558ccdULL;
+    imsi ^= imsi >> 33;
+    return imsi;
+  }
+}
+
+void S1apDB::EventTrace::Record(const TraceEntry& entry)
+{
+  entries_[count_ % TRACE_DEPTH] = {entry.timestamp,
+                                    static_cast<std::uint8_t>(entry.cause),
+                                    static_cast<std::uint8_t>(entry.oldState),
+                                    static_cast<std::uint8_t>(entry.newState)};
+  ++count_;
+}
+
+std::vector<S1apDB::TraceEntry> S1apDB::EventTrace::GetEntries() const
+{
+  std::vector<TraceEntry> entries;
+  const std::size_t first = count_ > TRACE_DEPTH ? count_ - TRACE_DEPTH : 0;
+
+  for (std::size_t i = first; i < count_; ++i)
+  {
+    const Packed& packed = entries_[i % TRACE_DEPTH];
+
+    entries.push_back({packed.timestamp,
+                       static_cast<Event::Type>(packed.cause),
+                       static_cast<SubscriberState>(packed.oldState),
+                       static_cast<SubscriberState>(packed.newState)});
+  }
+
+  return entries;
+}
+
+void S1apDB::SetTraceConfig(const TraceConfig& config)
+{
+  traceWatchlist_ = {config.watchlist.begin(), config.watchlist.end()};
+  traceSampleOneIn_ = config.sampleOneIn;
+  tracing_ = !traceWatchlist_.empty() || traceSampleOneIn_ != 0;
+
+  // Rings of subscribers that are no longer traced go; newly traced ones
+  // start empty.
+  std::erase_if(detachedTraces_, [this](const auto& entry) { return !traceWatchlist_.contains(entry.first); });
+
+  for (auto& [imsi, subscriber] : imsiToSubscriber)
+  {
+    if (!IsTraced(imsi))
+      subscriber.SetTrace(nullptr);
+    else if (subscriber.GetTrace() == nullptr)
+      subscriber.SetTrace(std::make_unique<EventTrace>());
+  }
+}
+
+std::vector<S1apDB::TraceEntry> S1apDB::GetTrace(S1ap::Imsi imsi) const
+{
+  if (const auto it = imsiToSubscriber.find(imsi); it != imsiToSubscriber.end() && it->second.GetTrace() != nullptr)
+    return it->second.GetTrace()->GetEntries();
+
+  if (const auto it = detachedTraces_.find(imsi); it != detachedTraces_.end())
+    return it->second->GetEntries();
+
+  return {};
+}
+
+bool S1apDB::IsTraced(S1ap::Imsi imsi) const
+{
+  return traceWatchlist_.contains(imsi)
+      || (traceSampleOneIn_ != 0 && MixImsi(imsi) % traceSampleOneIn_ == 0);
+}
+
+void S1apDB::StartTrace(Subscriber& subscriber)
+{
+  if (!tracing_) [[likely]]
+    return;
+
+  const auto imsi = subscriber.GetImsi().value();
+
+  if (auto it = detachedTraces_.find(imsi); it != detachedTraces_.end())
+  {
+    subscriber.SetTrace(std::move(it->second));
+    detachedTraces_.erase(it);
+  }
+  else if (IsTraced(imsi))
+    subscriber.SetTrace(std::make_unique<EventTrace>());
+}
+
+void S1apDB::NoteTrace(const Subscriber& subscriber, SubscriberState oldState, SubscriberState newState, const Event& event)
+{
+  auto* trace = subscriber.GetTrace();
+
+  // An event that reaches a second traced subscriber closes the first one's
+  // entry, so each still gets exactly one.
+  if (pendingTrace_.trace != trace)
+  {
+    if (pendingTrace_.trace != nullptr)
+      FlushTrace(event);
+
+    pendingTrace_ = {trace, oldState, newState};
+  }
+
+  pendingTrace_.newState = newState;
+}
+
+void S1apDB::FlushTrace(const Event& event)
+{
+  pendingTrace_.trace->Record({event.GetTimestamp(), event.GetType(), pendingTrace_.oldState, pendingTrace_.newState});
+  pendingTrace_.trace = nullptr;
+}
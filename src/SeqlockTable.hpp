@@ -0,0 +1,304 @@
+#ifndef SEQLOCK_TABLE_HPP
+#define SEQLOCK_TABLE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// Single-writer / multi-reader open addressing table.
+//
+// Every slot is guarded by its own seqlock, so readers retry instead of
+// blocking the writer. The slot array itself is published RCU-style: growing
+// builds a new version and swaps the pointer, readers still probing the old
+// version finish there. Retired versions are freed by the writer once both
+// reader generations seen since their retirement have drained; the writer
+// never waits for that, it just checks again on its next update.
+template <typename Key, typename Value>
+class SeqlockTable final
+{
+    static_assert(std::is_unsigned_v<Key>);
+    static_assert(std::is_trivially_copyable_v<Value>);
+    static_assert(std::is_default_constructible_v<Value>);
+
+  public:
+    // Slot arrays come from memory, which must outlive the table.
+    explicit SeqlockTable(std::size_t initialCapacity = 1024,
+                          std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+    : memory_(memory)
+    {
+      std::size_t capacity = 16;
+      while (capacity < initialCapacity)
+        capacity <<= 1;
+
+      Publish(std::make_unique<Version>(capacity, memory_));
+    }
+
+    SeqlockTable(const SeqlockTable&) = delete;
+    SeqlockTable& operator=(const SeqlockTable&) = delete;
+
+    // Writer only.
+    void Store(const Key key, const Value& value)
+    {
+      Reclaim();
+
+      if ((used_ + 1) * 2 > writerVersion_->capacity) [[unlikely]]
+        Grow();
+
+      Slot& slot = FindOrClaim(*writerVersion_, key);
+
+      if (!slot.present.load(std::memory_order_relaxed))
+        ++live_;
+
+      Write(slot, &value, true);
+    }
+
+    // Writer only. The slot keeps its key as a tombstone until the next grow.
+    void Erase(const Key key)
+    {
+      Reclaim();
+
+      Slot* slot = Find(*writerVersion_, key);
+
+      if (slot == nullptr || !slot->present.load(std::memory_order_relaxed))
+        return;
+
+      --live_;
+      Write(*slot, nullptr, false);
+    }
+
+    // Any thread.
+    std::optional<Value> Load(const Key key) const
+    {
+      const auto generation = generation_.load() & 1;
+      readers_[generation].fetch_add(1);
+
+      const Slot* slot = Find(*current_.load(), key);
+      std::optional<Value> value = slot == nullptr ? std::nullopt : Read(*slot);
+
+      readers_[generation].fetch_sub(1);
+      return value;
+    }
+
+    // Writer only. Sizes the table for count live keys up front, so a bulk
+    // load does not rehash on the way.
+    void Reserve(const std::size_t count)
+    {
+      Reclaim();
+
+      std::size_t capacity = writerVersion_->capacity;
+      while (count * 2 > capacity)
+        capacity <<= 1;
+
+      if (capacity != writerVersion_->capacity)
+        Rehash(capacity);
+    }
+
+    // Writer only.
+    std::size_t Size() const { return live_; }
+
+  private:
+    static constexpr std::size_t WORDS = (sizeof(Value) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    struct Slot
+    {
+      std::atomic<std::uint64_t> seq{0};
+      std::atomic<bool> used{false};
+      std::atomic<Key> key{0};
+      std::atomic<bool> present{false};
+      std::array<std::atomic<std::uint64_t>, WORDS> words{};
+    };
+
+    struct Version
+    {
+      Version(std::size_t capacity_, std::pmr::memory_resource* memory_)
+      : capacity(capacity_),
+        mask(capacity_ - 1),
+        memory(memory_),
+        slots(static_cast<Slot*>(memory_->allocate(capacity_ * sizeof(Slot), alignof(Slot))))
+      {
+        std::uninitialized_value_construct_n(slots, capacity);
+      }
+
+      ~Version()
+      {
+        std::destroy_n(slots, capacity);
+        memory->deallocate(slots, capacity * sizeof(Slot), alignof(Slot));
+      }
+
+      Version(const Version&) = delete;
+      Version& operator=(const Version&) = delete;
+
+      std::size_t capacity;
+      std::size_t mask;
+      std::pmr::memory_resource* memory;
+      Slot* slots;
+    };
+
+    static std::size_t Hash(Key key)
+    {
+      std::uint64_t x = static_cast<std::uint64_t>(key);
+      x ^= x >> 33;
+      x *= 0xff51afd7ed558ccdULL;
+      x ^= x >> 33;
+      x *= 0xc4ceb9fe1a85ec53ULL;
+      x ^= x >> 33;
+      return static_cast<std::size_t>(x);
+    }
+
+    static Slot* Find(const Version& version, const Key key)
+    {
+      for (std::size_t i = Hash(key) & version.mask;; i = (i + 1) & version.mask)
+      {
+        Slot& slot = version.slots[i];
+
+        if (!slot.used.load(std::memory_order_acquire))
+          return nullptr;
+        if (slot.key.load(std::memory_order_relaxed) == key)
+          return &slot;
+      }
+    }
+
+    Slot& FindOrClaim(Version& version, const Key key)
+    {
+      for (std::size_t i = Hash(key) & version.mask;; i = (i + 1) & version.mask)
+      {
+        Slot& slot = version.slots[i];
+
+        if (!slot.used.load(std::memory_order_relaxed))
+        {
+          slot.key.store(key, std::memory_order_relaxed);
+          slot.used.store(true, std::memory_order_release);
+          ++used_;
+          return slot;
+        }
+
+        if (slot.key.load(std::memory_order_relaxed) == key)
+          return slot;
+      }
+    }
+
+    static void Write(Slot& slot, const Value* value, const bool present)
+    {
+      std::array<std::uint64_t, WORDS> buffer{};
+      if (value != nullptr)
+        std::memcpy(buffer.data(), value, sizeof(Value));
+
+      const auto seq = slot.seq.load(std::memory_order_relaxed);
+      slot.seq.store(seq + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      slot.present.store(present, std::memory_order_relaxed);
+      for (std::size_t i = 0; i < WORDS; ++i)
+        slot.words[i].store(buffer[i], std::memory_order_relaxed);
+
+      slot.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    static std::optional<Value> Read(const Slot& slot)
+    {
+      std::array<std::uint64_t, WORDS> buffer;
+      bool present;
+
+      for (;;)
+      {
+        const auto before = slot.seq.load(std::memory_order_acquire);
+        if (before & 1) [[unlikely]]
+          continue;
+
+        present = slot.present.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < WORDS; ++i)
+          buffer[i] = slot.words[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == before) [[likely]]
+          break;
+      }
+
+      if (!present)
+        return std::nullopt;
+
+      Value value;
+      std::memcpy(&value, buffer.data(), sizeof(Value));
+      return value;
+    }
+
+    void Grow()
+    {
+      std::size_t capacity = writerVersion_->capacity;
+      while ((live_ + 1) * 4 > capacity)
+        capacity <<= 1;
+
+      Rehash(capacity);
+    }
+
+    void Rehash(const std::size_t capacity)
+    {
+      auto next = std::make_unique<Version>(capacity, memory_);
+      used_ = 0;
+
+      for (std::size_t i = 0; i < writerVersion_->capacity; ++i)
+      {
+        const Slot& from = writerVersion_->slots[i];
+        if (!from.used.load(std::memory_order_relaxed) || !from.present.load(std::memory_order_relaxed))
+          continue;
+
+        Slot& to = FindOrClaim(*next, from.key.load(std::memory_order_relaxed));
+        to.present.store(true, std::memory_order_relaxed);
+        for (std::size_t w = 0; w < WORDS; ++w)
+          to.words[w].store(from.words[w].load(std::memory_order_relaxed), std::memory_order_relaxed);
+      }
+
+      Publish(std::move(next));
+    }
+
+    void Publish(std::unique_ptr<Version> version)
+    {
+      if (writerVersion_ != nullptr)
+        retired_.push_back(std::move(owned_));
+
+      writerVersion_ = version.get();
+      owned_ = std::move(version);
+      current_.store(writerVersion_);
+    }
+
+    // Versions in draining_ were retired before the last generation flip, so
+    // only readers counted in the previous generation can still hold them.
+    void Reclaim()
+    {
+      if (draining_.empty() && retired_.empty())
+        return;
+
+      const auto previous = (generation_.load() & 1) ^ 1;
+      if (readers_[previous].load() != 0)
+        return;
+
+      draining_ = std::move(retired_);
+      retired_.clear();
+
+      if (!draining_.empty())
+        generation_.fetch_add(1);
+    }
+
+    std::pmr::memory_resource* memory_;
+
+    std::atomic<const Version*> current_{nullptr};
+    Version* writerVersion_ = nullptr;
+    std::unique_ptr<Version> owned_;
+
+    std::atomic<unsigned> generation_{0};
+    mutable std::array<std::atomic<std::size_t>, 2> readers_{};
+    std::vector<std::unique_ptr<Version>> retired_;
+    std::vector<std::unique_ptr<Version>> draining_;
+
+    std::size_t used_ = 0;
+    std::size_t live_ = 0;
+};
+
+#endif // SEQLOCK_TABLE_HPP
@@ -0,0 +1,47 @@
+#ifndef TOKEN_BUCKET_HPP
+#define TOKEN_BUCKET_HPP
+
+#include <algorithm>
+#include <cstdint>
+
+// Token bucket refilled from the caller's clock rather than the wall clock,
+// so replaying the same timestamps gives the same decisions. Time is in
+// milliseconds; a clock going backwards just refills nothing.
+class TokenBucket final
+{
+  public:
+    TokenBucket(double tokensPerSecond, double capacity)
+    : rate_(tokensPerSecond / 1000.0),
+      capacity_(capacity),
+      tokens_(capacity) {}
+
+    bool TryTake(const std::uint64_t nowMs)
+    {
+      if (nowMs > lastMs_)
+      {
+        tokens_ = std::min(capacity_, tokens_ + static_cast<double>(nowMs - lastMs_) * rate_);
+        lastMs_ = nowMs;
+      }
+
+      if (tokens_ < 1.0)
+        return false;
+
+      tokens_ -= 1.0;
+      return true;
+    }
+
+    // A full bucket behaves exactly like a fresh one.
+    bool IsFull(const std::uint64_t nowMs) const
+    {
+      const auto elapsed = nowMs > lastMs_ ? nowMs - lastMs_ : 0;
+      return tokens_ + static_cast<double>(elapsed) * rate_ >= capacity_;
+    }
+
+  private:
+    double rate_;
+    double capacity_;
+    double tokens_;
+    std::uint64_t lastMs_ = 0;
+};
+
+#endif // TOKEN_BUCKET_HPP
@@ -0,0 +1,544 @@
+#include "gtest/gtest.h"
+#include "Executor.hpp"
+#include "S1apDB.hpp"
+#include "S1apShardRouter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Stress and linearizability harness for the sharded S1apDB.
+//
+// SHARDS writer threads each own one S1apDB through a ThreadExecutor. CLIENTS
+// threads drive the state machine through them: every client owns a disjoint
+// set of subscribers and eNodeB IDs, submits one event at a time, and checks
+// each result against a sequential reference model of its own subscribers.
+// Disjoint ownership makes each client's history independent of how the
+// clients interleave, so the expected outcome of every operation is a pure
+// function of the seed; only the M-TMSI values depend on scheduling and the
+// model learns them from the database. The shared per-shard indexes are what
+// actually races: a lost or stale mTmsiToImsi / enodebIDToImsi entry shows up
+// as a wrong outcome for some later event. READERS threads meanwhile hit the
+// lock-free Lookup() paths and the state change feeds.
+//
+// S1AP_STRESS_SEED and S1AP_STRESS_OPERATIONS override the defaults; a
+// failure prints the seed and the history of the subscriber that diverged.
+namespace {
+    constexpr unsigned SHARDS = 4;
+    constexpr unsigned CLIENTS = 8;
+    constexpr unsigned READERS = 2;
+    constexpr std::size_t SUBSCRIBERS_PER_CLIENT = 64;
+    constexpr S1ap::Imsi FIRST_IMSI = 250020000000000;
+    constexpr S1ap::MmeID MME_ID = 1;
+    constexpr std::size_t HISTORY_DUMP = 16;
+
+    std::uint64_t GetEnv(const char* name, std::uint64_t fallback) {
+        const char* value = std::getenv(name);
+        return value != nullptr ? std::stoull(value) : fallback;
+    }
+
+    using State = S1apDB::SubscriberState;
+
+    struct Outcome {
+        enum class Kind { Out, Nothing, Failed };
+
+        Kind kind = Kind::Nothing;
+        S1apOut::Type outType = S1apOut::Type::Reg;
+        S1apDB::HandleError error{};
+
+        static Outcome Out(S1apOut::Type type) { return {Kind::Out, type, {}}; }
+        static Outcome Nothing() { return {}; }
+        static Outcome Failed(S1apDB::Error error) { return {Kind::Failed, {}, error}; }
+
+        static Outcome From(const S1apDB::HandleOut& result) {
+            if (!result.has_value())
+                return {Kind::Failed, {}, result.error()};
+            if (!result->has_value())
+                return Nothing();
+            return Out(result->value().GetType());
+        }
+
+        bool operator==(const Outcome& other) const {
+            if (kind != other.kind)
+                return false;
+            if (kind == Kind::Out)
+                return outType == other.outType;
+            if (kind == Kind::Failed)
+                return error == other.error;
+            return true;
+        }
+
+        std::string ToString() const {
+            switch (kind) {
+                case Kind::Out:
+                    return "out " + std::to_string(static_cast<int>(outType));
+                case Kind::Nothing:
+                    return "nothing";
+                case Kind::Failed:
+                    return "error " + std::to_string(error.index()) + ":" +
+                           std::to_string(std::visit([](auto e) { return static_cast<int>(e); }, error));
+            }
+            return {};
+        }
+    };
+
+    // Blocking call into the shard that owns the S1apDB.
+    class HandleCall final : public ExecutorTask {
+      public:
+        HandleCall(S1apDB& db, const Event& event) : db_(db), event_(event) {}
+
+        void Run() override {
+            result_ = db_.Handle(event_);
+            done_.store(true, std::memory_order_release);
+            done_.notify_one();
+        }
+
+        S1apDB::HandleOut Wait() {
+            done_.wait(false, std::memory_order_acquire);
+            return std::move(result_).value();
+        }
+
+      private:
+        S1apDB& db_;
+        const Event& event_;
+        std::optional<S1apDB::HandleOut> result_;
+        std::atomic<bool> done_{false};
+    };
+
+    // Sequential model of the subset of the state machine the clients use,
+    // restricted to one client's subscribers. It mirrors the shard indexes
+    // entry by entry, stale eNodeB mappings left behind by re-attach included.
+    class ReferenceModel {
+      public:
+        struct Subscriber {
+            State state = State::ATTACHED;
+            std::optional<S1ap::MTmsi> mTmsi;
+            S1ap::EnodebID enodebID = 0;
+        };
+
+        // Expected outcome of event on the given shard; updates the model.
+        Outcome Apply(const Event& event, unsigned shard) {
+            switch (event.GetType()) {
+                case Event::Type::AttachRequest:
+                    return ApplyAttach(event, shard);
+                case Event::Type::Paging:
+                    return ApplyPaging(event);
+                case Event::Type::PathSwitchRequest:
+                    return ApplyPathSwitch(event, shard);
+                case Event::Type::UEContextReleaseResponse:
+                    return ApplyRelease(event, shard);
+                default:
+                    return Outcome::Failed(S1apDB::Error::InvalidStateForEvent);
+            }
+        }
+
+        // A new subscriber got its M-TMSI from the database.
+        void LearnMTmsi(S1ap::Imsi imsi, S1ap::MTmsi mTmsi) {
+            subscribers_.at(imsi).mTmsi = mTmsi;
+            mTmsiToImsi_[mTmsi] = imsi;
+        }
+
+        const Subscriber* Find(S1ap::Imsi imsi) const {
+            auto it = subscribers_.find(imsi);
+            return it != subscribers_.end() ? &it->second : nullptr;
+        }
+
+      private:
+        Outcome ApplyAttach(const Event& event, unsigned shard) {
+            S1ap::Imsi imsi;
+
+            if (event.GetImsi().has_value()) {
+                imsi = event.GetImsi().value();
+            } else {
+                auto it = mTmsiToImsi_.find(event.GetMTmsi().value());
+                if (it == mTmsiToImsi_.end())
+                    return Outcome::Nothing();
+                imsi = it->second;
+            }
+
+            const auto enodebID = event.GetEnodebID().value();
+            auto it = subscribers_.find(imsi);
+
+            if (it == subscribers_.end()) {
+                subscribers_[imsi] = Subscriber{State::ATTACHED, std::nullopt, enodebID};
+                enodebToImsi_[{shard, enodebID}] = imsi;
+                return Outcome::Out(S1apOut::Type::Reg);
+            }
+
+            if (it->second.state == State::ATTACHED)
+                return Outcome::Nothing();
+
+            it->second.state = State::ATTACHED;
+            it->second.enodebID = enodebID;
+            enodebToImsi_[{shard, enodebID}] = imsi;
+            return Outcome::Out(S1apOut::Type::Reg);
+        }
+
+        Outcome ApplyPaging(const Event& event) {
+            auto it = mTmsiToImsi_.find(event.GetMTmsi().value());
+            if (it == mTmsiToImsi_.end())
+                return Outcome::Failed(S1apDB::Error::MTmsiNotExists);
+
+            auto& subscriber = subscribers_.at(it->second);
+            if (subscriber.state == State::ATTACHED)
+                subscriber.state = State::PAGING_STATE;
+
+            return Outcome::Nothing();
+        }
+
+        Outcome ApplyPathSwitch(const Event& event, unsigned shard) {
+            const auto oldEnodebID = event.GetEnodebID().value();
+            auto mapping = enodebToImsi_.find({shard, oldEnodebID});
+            if (mapping == enodebToImsi_.end())
+                return Outcome::Failed(S1apDB::Error::SubscriberNotFound);
+
+            const auto imsi = mapping->second;
+            auto it = subscribers_.find(imsi);
+            if (it == subscribers_.end())
+                return Outcome::Failed(S1apDB::Error::SubscriberNotFound);
+            if (it->second.state != State::ATTACHED)
+                return Outcome::Failed(S1apDB::Error::WrongState);
+
+            const S1ap::EnodebID newEnodebID = event.GetCgi().value().front();
+
+            enodebToImsi_.erase(mapping);
+            enodebToImsi_[{shard, newEnodebID}] = imsi;
+            it->second.enodebID = newEnodebID;
+            it->second.state = State::HANDOVER_STATE;
+            return Outcome::Out(S1apOut::Type::CgiChange);
+        }
+
+        Outcome ApplyRelease(const Event& event, unsigned shard) {
+            auto mapping = enodebToImsi_.find({shard, event.GetEnodebID().value()});
+            if (mapping == enodebToImsi_.end())
+                return Outcome::Failed(S1apDB::Error::SubscriberNotFound);
+
+            const auto imsi = mapping->second;
+            auto it = subscribers_.find(imsi);
+            if (it == subscribers_.end())
+                return Outcome::Failed(S1apDB::Error::SubscriberNotFound);
+
+            mTmsiToImsi_.erase(it->second.mTmsi.value());
+            enodebToImsi_.erase({shard, it->second.enodebID});
+            subscribers_.erase(it);
+            return Outcome::Out(S1apOut::Type::UnReg);
+        }
+
+        std::map<S1ap::Imsi, Subscriber> subscribers_;
+        std::unordered_map<S1ap::MTmsi, S1ap::Imsi> mTmsiToImsi_;
+        std::map<std::pair<unsigned, S1ap::EnodebID>, S1ap::Imsi> enodebToImsi_;
+    };
+
+    struct HistoryEntry {
+        std::size_t operation;
+        Event::Type type;
+        Outcome expected;
+        Outcome actual;
+        std::optional<State> state;
+    };
+
+    struct Cluster {
+        S1apShardRouter router{SHARDS};
+        std::vector<std::unique_ptr<S1apDB>> shards;
+        std::vector<std::unique_ptr<ThreadExecutor>> owners;
+
+        Cluster() {
+            for (unsigned i = 0; i < SHARDS; ++i) {
+                shards.push_back(std::make_unique<S1apDB>(S1apDB::ShardConfig{.shardCount = SHARDS, .shardIndex = i}));
+                owners.push_back(std::make_unique<ThreadExecutor>());
+            }
+        }
+
+        S1apDB::HandleOut Call(unsigned shard, const Event& event) {
+            HandleCall call(*shards[shard], event);
+            owners[shard]->Post(call);
+            return call.Wait();
+        }
+    };
+
+    class Client {
+      public:
+        Client(Cluster& cluster, unsigned index, std::uint64_t seed)
+        : cluster_(cluster), index_(index), random_(seed * 1000003 + index) {
+            for (std::size_t i = 0; i < SUBSCRIBERS_PER_CLIENT; ++i)
+                imsis_.push_back(FIRST_IMSI + index * SUBSCRIBERS_PER_CLIENT + i);
+        }
+
+        // Returns an empty string, or a report of the first divergence.
+        std::string Run(std::size_t operations) {
+            for (std::size_t operation = 0; operation < operations; ++operation) {
+                const auto slot = std::uniform_int_distribution<std::size_t>(0, imsis_.size() - 1)(random_);
+                const auto imsi = imsis_[slot];
+                const auto shard = cluster_.router.ShardOfImsi(imsi);
+                const auto event = NextEvent(slot, imsi);
+
+                const auto expected = model_.Apply(event, shard);
+                const auto actual = Outcome::From(cluster_.Call(shard, event));
+
+                auto& history = histories_[imsi];
+                const auto* modelled = model_.Find(imsi);
+                history.push_back({operation, event.GetType(), expected, actual,
+                                   modelled ? std::optional(modelled->state) : std::nullopt});
+
+                if (!(expected == actual))
+                    return Report(imsi, "unexpected outcome");
+
+                if (auto mismatch = CheckSubscriber(imsi, shard); !mismatch.empty())
+                    return Report(imsi, mismatch);
+            }
+
+            return {};
+        }
+
+        // Compare the database with the model for every owned subscriber.
+        std::string CheckAll() {
+            for (const auto imsi : imsis_)
+                if (auto mismatch = CheckSubscriber(imsi, cluster_.router.ShardOfImsi(imsi)); !mismatch.empty())
+                    return Report(imsi, mismatch);
+            return {};
+        }
+
+        const std::vector<S1ap::MTmsi>& GetAllocatedMTmsis() const { return allocated_; }
+
+      private:
+        S1ap::EnodebID HomeEnodeb(std::size_t slot, unsigned which) const {
+            return static_cast<S1ap::EnodebID>(256 + (index_ * SUBSCRIBERS_PER_CLIENT + slot) * 2 + which);
+        }
+
+        S1ap::Cgi MakeCgi(std::size_t slot) const {
+            // The first byte is the handover target eNodeB, one per client.
+            return {static_cast<unsigned char>(index_ + 1), 0xf0, static_cast<unsigned char>(slot)};
+        }
+
+        Event NextEvent(std::size_t slot, S1ap::Imsi imsi) {
+            const auto timestamp = ++timestamp_;
+            const auto* subscriber = model_.Find(imsi);
+            const int action = std::uniform_int_distribution<int>(0, 99)(random_);
+            const auto& retired = retired_[imsi];
+
+            if (subscriber == nullptr || !subscriber->mTmsi.has_value()) {
+                if (action < 10 && !retired.empty())
+                    return Event::CreatePaging(timestamp, retired.back(), MakeCgi(slot));
+                if (action < 15 && !retired.empty())
+                    return Event::CreateAttachRequestWithMTmsi(timestamp, HomeEnodeb(slot, 0), retired.back(), MakeCgi(slot));
+                if (action < 20)
+                    return Event::CreateUEContextReleaseResponse(timestamp, HomeEnodeb(slot, 1), MME_ID);
+                return Event::CreateAttachRequestWithImsi(timestamp, imsi, HomeEnodeb(slot, action & 1), MakeCgi(slot));
+            }
+
+            const auto mTmsi = subscriber->mTmsi.value();
+
+            if (action < 15)
+                return Event::CreateAttachRequestWithImsi(timestamp, imsi, HomeEnodeb(slot, action & 1), MakeCgi(slot));
+            if (action < 25)
+                return Event::CreateAttachRequestWithMTmsi(timestamp, HomeEnodeb(slot, action & 1), mTmsi, MakeCgi(slot));
+            if (action < 45)
+                return Event::CreatePaging(timestamp, mTmsi, MakeCgi(slot));
+            if (action < 55)
+                return Event::CreatePathSwitchRequest(timestamp, subscriber->enodebID, MME_ID, MakeCgi(slot));
+            if (action < 60)
+                return Event::CreatePathSwitchRequest(timestamp, HomeEnodeb(slot, action & 1), MME_ID, MakeCgi(slot));
+            if (action < 65)
+                return Event::CreateUEContextReleaseResponse(timestamp, HomeEnodeb(slot, action & 1), MME_ID);
+
+            retired_[imsi].push_back(mTmsi);
+            return Event::CreateUEContextReleaseResponse(timestamp, subscriber->enodebID, MME_ID);
+        }
+
+        std::string CheckSubscriber(S1ap::Imsi imsi, unsigned shard) {
+            auto& db = *cluster_.shards[shard];
+            const auto* modelled = model_.Find(imsi);
+            const auto view = db.Lookup(imsi);
+
+            if (modelled == nullptr)
+                return view.has_value() ? "released subscriber is still published" : "";
+
+            if (!view.has_value())
+                return "subscriber is missing";
+            if (view->state != modelled->state)
+                return "state differs from the model";
+            if (view->enodebID != modelled->enodebID)
+                return "eNodeB ID differs from the model";
+
+            if (!modelled->mTmsi.has_value()) {
+                if (!view->mTmsi.has_value())
+                    return "new subscriber has no M-TMSI";
+                if (cluster_.router.ShardOfMTmsi(view->mTmsi.value()) != shard)
+                    return "M-TMSI does not encode the owning shard";
+
+                model_.LearnMTmsi(imsi, view->mTmsi.value());
+                allocated_.push_back(view->mTmsi.value());
+            } else if (view->mTmsi != modelled->mTmsi) {
+                return "M-TMSI changed while attached";
+            }
+
+            auto byMTmsi = db.LookupByMTmsi(view->mTmsi.value());
+            if (!byMTmsi.has_value() || byMTmsi->imsi != imsi)
+                return "M-TMSI index does not resolve to the subscriber";
+
+            return {};
+        }
+
+        std::string Report(S1ap::Imsi imsi, const std::string& what) const {
+            std::ostringstream report;
+            report << "client " << index_ << ", IMSI " << imsi << ": " << what << "\n";
+
+            const auto& history = histories_.at(imsi);
+            const auto first = history.size() > HISTORY_DUMP ? history.size() - HISTORY_DUMP : 0;
+
+            for (std::size_t i = first; i < history.size(); ++i) {
+                const auto& entry = history[i];
+                report << "  #" << entry.operation << " type " << static_cast<int>(entry.type)
+                       << " expected " << entry.expected.ToString() << " actual " << entry.actual.ToString()
+                       << " model state " << (entry.state ? static_cast<int>(*entry.state) : -1) << "\n";
+            }
+
+            return report.str();
+        }
+
+        Cluster& cluster_;
+        unsigned index_;
+        std::mt19937_64 random_;
+        ReferenceModel model_;
+        S1ap::Timestamp timestamp_ = 0;
+        std::vector<S1ap::Imsi> imsis_;
+        std::map<S1ap::Imsi, std::vector<HistoryEntry>> histories_;
+        std::map<S1ap::Imsi, std::vector<S1ap::MTmsi>> retired_;
+        std::vector<S1ap::MTmsi> allocated_;
+    };
+
+    // Invariants that must hold for every snapshot a reader can observe.
+    void ReadLoop(Cluster& cluster, std::uint64_t seed, const std::atomic<bool>& stop,
+                  std::atomic<std::uint64_t>& lookups, std::atomic<std::uint64_t>& violations) {
+        std::mt19937_64 random(seed);
+        std::uniform_int_distribution<S1ap::Imsi> pick(FIRST_IMSI, FIRST_IMSI + CLIENTS * SUBSCRIBERS_PER_CLIENT - 1);
+        std::uint64_t done = 0;
+
+        while (!stop.load(std::memory_order_relaxed)) {
+            const auto imsi = pick(random);
+            const auto shard = cluster.router.ShardOfImsi(imsi);
+            const auto view = cluster.shards[shard]->Lookup(imsi);
+            ++done;
+
+            if (!view.has_value())
+                continue;
+
+            if (view->imsi != imsi || !view->mTmsi.has_value() || !view->enodebID.has_value()
+            ||  cluster.router.ShardOfMTmsi(view->mTmsi.value()) != shard) {
+                ++violations;
+                continue;
+            }
+
+            // May already be gone or re-assigned, but never to someone else.
+            const auto byMTmsi = cluster.shards[shard]->LookupByMTmsi(view->mTmsi.value());
+            if (byMTmsi.has_value() && byMTmsi->imsi != imsi)
+                ++violations;
+        }
+
+        lookups += done;
+    }
+
+    // Per subscriber, each change must start from the state the previous one
+    // ended in, unless the consumer lagged and lost entries in between.
+    void FeedLoop(const S1apDB& db, const std::atomic<bool>& stop, std::atomic<std::uint64_t>& changes,
+                  std::atomic<std::uint64_t>& violations) {
+        auto cursor = db.GetStateChangeFeed().Subscribe();
+        std::vector<S1apDB::StateChange> batch(256);
+        std::unordered_map<S1ap::Imsi, State> last;
+        std::uint64_t seen = 0;
+
+        for (;;) {
+            const bool stopping = stop.load(std::memory_order_acquire);
+            const auto polled = db.GetStateChangeFeed().Poll(cursor, batch);
+
+            if (polled.lost != 0)
+                last.clear();
+
+            for (std::size_t i = 0; i < polled.count; ++i) {
+                const auto& change = batch[i];
+                auto it = last.find(change.imsi);
+
+                if (it != last.end() && it->second != change.oldState)
+                    ++violations;
+
+                last[change.imsi] = change.newState;
+            }
+
+            seen += polled.count;
+
+            if (polled.count == 0) {
+                if (stopping)
+                    break;
+                std::this_thread::yield();
+            }
+        }
+
+        changes += seen;
+    }
+}
+
+TEST(S1apStressTest, ShardedHistoriesMatchReferenceModel) {
+    const auto seed = GetEnv("S1AP_STRESS_SEED", 1);
+    const auto operations = GetEnv("S1AP_STRESS_OPERATIONS", 20000);
+    SCOPED_TRACE("S1AP_STRESS_SEED=" + std::to_string(seed));
+
+    Cluster cluster;
+    std::vector<std::unique_ptr<Client>> clients;
+    std::vector<std::string> reports(CLIENTS);
+
+    for (unsigned i = 0; i < CLIENTS; ++i)
+        clients.push_back(std::make_unique<Client>(cluster, i, seed));
+
+    std::atomic<bool> stop{false};
+    std::atomic<std::uint64_t> lookups{0};
+    std::atomic<std::uint64_t> changes{0};
+    std::atomic<std::uint64_t> readViolations{0};
+    std::atomic<std::uint64_t> feedViolations{0};
+    std::vector<std::thread> observers;
+
+    for (unsigned i = 0; i < READERS; ++i)
+        observers.emplace_back(ReadLoop, std::ref(cluster), seed + i, std::cref(stop), std::ref(lookups),
+                               std::ref(readViolations));
+    for (unsigned i = 0; i < SHARDS; ++i)
+        observers.emplace_back(FeedLoop, std::cref(*cluster.shards[i]), std::cref(stop), std::ref(changes),
+                               std::ref(feedViolations));
+
+    {
+        std::vector<std::jthread> workers;
+        for (unsigned i = 0; i < CLIENTS; ++i)
+            workers.emplace_back([&, i] { reports[i] = clients[i]->Run(operations); });
+    }
+
+    stop.store(true, std::memory_order_release);
+    for (auto& observer : observers)
+        observer.join();
+
+    for (const auto& report : reports)
+        ASSERT_TRUE(report.empty()) << report;
+
+    for (const auto& client : clients) {
+        const auto report = client->CheckAll();
+        ASSERT_TRUE(report.empty()) << report;
+    }
+
+    std::vector<S1ap::MTmsi> allocated;
+    for (const auto& client : clients)
+        allocated.insert(allocated.end(), client->GetAllocatedMTmsis().begin(), client->GetAllocatedMTmsis().end());
+
+    std::ranges::sort(allocated);
+    ASSERT_EQ(std::ranges::adjacent_find(allocated), allocated.end()) << "an M-TMSI was handed out twice";
+
+    ASSERT_EQ(readViolations.load(), 0u);
+    ASSERT_EQ(feedViolations.load(), 0u);
+    ASSERT_GT(lookups.load(), 0u);
+    ASSERT_GT(changes.load(), 0u);
+}
@@ -1,5 +1,23 @@
 #include "gtest/gtest.h"
+#include "S1apCodec.hpp"
+#include "S1apAsync.hpp"
 #include "S1apDB.hpp"
+#include "S1apIngest.hpp"
+#include "S1apReplication.hpp"
+#include "S1apShardRouter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <coroutine>
+#include <latch>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <unistd.h>
 
 TEST(EventTest, GettersReturnCorrectValues) {
     S1ap::Timestamp timestamp = 12345;
@@ -78,3 +96,888 @@ TEST(S1apDBTest, HandleAttachRequest) {
     ASSERT_EQ(result.value().value().GetType(), S1apOut::Type::Reg);
     ASSERT_EQ(result.value().value().GetImsi(), imsi);
 }
+
+TEST(S1apDBTest, LookupReturnsPublishedSubscriber) {
+    S1apDB& db = S1apDB::GetInstance();
+    S1ap::Imsi imsi = 223456789;
+    S1ap::EnodebID enodebID = 2000;
+    S1ap::Cgi cgi = {0x04, 0x05, 0x06};
+
+    ASSERT_FALSE(db.Lookup(imsi).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(20000, imsi, enodebID, cgi)).has_value());
+
+    auto view = db.Lookup(imsi);
+    ASSERT_TRUE(view.has_value());
+    ASSERT_EQ(view->imsi, imsi);
+    ASSERT_EQ(view->state, S1apDB::SubscriberState::ATTACHED);
+    ASSERT_EQ(view->enodebID, enodebID);
+    ASSERT_EQ(view->cgi, cgi);
+    ASSERT_TRUE(view->mTmsi.has_value());
+
+    auto byMTmsi = db.LookupByMTmsi(view->mTmsi.value());
+    ASSERT_TRUE(byMTmsi.has_value());
+    ASSERT_EQ(byMTmsi->imsi, imsi);
+
+    ASSERT_TRUE(db.Handle(Event::CreateUEContextReleaseResponse(20001, enodebID, 1)).has_value());
+    ASSERT_FALSE(db.Lookup(imsi).has_value());
+    ASSERT_FALSE(db.LookupByMTmsi(view->mTmsi.value()).has_value());
+}
+
+TEST(S1apDBTest, LookupIsConsistentWhileWriterRuns) {
+    S1apDB& db = S1apDB::GetInstance();
+    constexpr S1ap::Imsi FIRST_IMSI = 300000000;
+    constexpr unsigned SUBSCRIBERS = 20000;
+
+    std::atomic<bool> done = false;
+    std::atomic<unsigned long> torn = 0;
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r)
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                for (unsigned i = 0; i < SUBSCRIBERS; i += 97) {
+                    auto view = db.Lookup(FIRST_IMSI + i);
+                    if (!view.has_value())
+                        continue;
+                    const auto expectedEnodeb = static_cast<S1ap::EnodebID>(100000 + i);
+                    const auto expectedCgi = S1ap::Cgi{static_cast<unsigned char>(i), static_cast<unsigned char>(i >> 8)};
+                    if (view->imsi != FIRST_IMSI + i || view->enodebID != expectedEnodeb || view->cgi != expectedCgi)
+                        ++torn;
+                }
+            }
+        });
+
+    for (unsigned i = 0; i < SUBSCRIBERS; ++i) {
+        S1ap::Cgi cgi = {static_cast<unsigned char>(i), static_cast<unsigned char>(i >> 8)};
+        db.Handle(Event::CreateAttachRequestWithImsi(30000 + i, FIRST_IMSI + i, 100000 + i, cgi));
+    }
+    for (unsigned i = 0; i < SUBSCRIBERS; i += 2)
+        db.Handle(Event::CreateUEContextReleaseResponse(60000 + i, 100000 + i, 1));
+
+    done = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    ASSERT_EQ(torn.load(), 0u);
+    ASSERT_FALSE(db.Lookup(FIRST_IMSI).has_value());
+    ASSERT_TRUE(db.Lookup(FIRST_IMSI + 1).has_value());
+}
+
+TEST(S1apDBTest, StateChangeFeedReportsTransitions) {
+    S1apDB& db = S1apDB::GetInstance();
+    S1ap::Imsi imsi = 423456789;
+    S1ap::EnodebID enodebID = 4000;
+    S1ap::Cgi cgi = {0x07, 0x08, 0x09};
+
+    const auto& feed = db.GetStateChangeFeed();
+    auto cursor = feed.Subscribe();
+
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(40000, imsi, enodebID, cgi)).has_value());
+    auto mTmsi = db.Lookup(imsi)->mTmsi.value();
+    ASSERT_TRUE(db.Handle(Event::CreatePaging(40001, mTmsi, cgi)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateUEContextReleaseResponse(40002, enodebID, 1)).has_value());
+
+    std::array<S1apDB::StateChange, 8> changes{};
+    auto polled = feed.Poll(cursor, changes);
+
+    ASSERT_EQ(polled.lost, 0u);
+    ASSERT_EQ(polled.count, 3u);
+
+    ASSERT_EQ(changes[0].imsi, imsi);
+    ASSERT_EQ(changes[0].oldState, S1apDB::SubscriberState::DETACHED);
+    ASSERT_EQ(changes[0].newState, S1apDB::SubscriberState::ATTACHED);
+    ASSERT_EQ(changes[0].timestamp, 40000u);
+
+    ASSERT_EQ(changes[1].oldState, S1apDB::SubscriberState::ATTACHED);
+    ASSERT_EQ(changes[1].newState, S1apDB::SubscriberState::PAGING_STATE);
+    ASSERT_EQ(changes[1].cause, Event::Type::Paging);
+    ASSERT_EQ(changes[1].sequence, changes[0].sequence + 1);
+
+    ASSERT_EQ(changes[2].newState, S1apDB::SubscriberState::DETACHED);
+    ASSERT_EQ(feed.Poll(cursor, changes).count, 0u);
+}
+
+TEST(BroadcastRingTest, LaggingConsumerIsToldWhatItLost) {
+    BroadcastRing<unsigned long> ring(16);
+    auto slow = ring.Subscribe();
+
+    for (unsigned long i = 0; i < 40; ++i)
+        ring.Push(i);
+    ring.Publish();
+
+    std::array<unsigned long, 64> out{};
+    auto polled = ring.Poll(slow, out);
+
+    ASSERT_EQ(polled.lost, 24u);
+    ASSERT_EQ(polled.count, 16u);
+    ASSERT_EQ(out[0], 24u);
+    ASSERT_EQ(out[15], 39u);
+}
+
+TEST(S1apCodecTest, EventsRoundTrip) {
+    std::vector<Event> events;
+    for (unsigned i = 0; i < 50; ++i) {
+        S1ap::Cgi cgi = {0x01, static_cast<unsigned char>(i)};
+        events.push_back(Event::CreateAttachRequestWithImsi(i, 1000 + i, 10 + i, cgi));
+        events.push_back(Event::CreateAttachRequestWithMTmsi(i, 10 + i, 5000 + i, cgi));
+        events.push_back(Event::CreateAttachAccept(i, 10 + i, 7, 5000 + i));
+        events.push_back(Event::CreateUEContextReleaseResponse(i, 10 + i, 7));
+    }
+
+    std::vector<std::byte> frame;
+    ASSERT_TRUE(S1apCodec::Encode(std::span<const Event>(events), frame).has_value());
+
+    std::vector<Event> decoded;
+    auto stats = S1apCodec::Decode(frame, decoded);
+
+    ASSERT_TRUE(stats.has_value());
+    ASSERT_EQ(stats->frameSize, frame.size());
+    ASSERT_EQ(stats->decoded, events.size());
+    ASSERT_EQ(stats->rejected, 0u);
+
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        ASSERT_EQ(decoded[i].GetType(), events[i].GetType());
+        ASSERT_EQ(decoded[i].GetTimestamp(), events[i].GetTimestamp());
+        ASSERT_EQ(decoded[i].GetImsi(), events[i].GetImsi());
+        ASSERT_EQ(decoded[i].GetMTmsi(), events[i].GetMTmsi());
+        ASSERT_EQ(decoded[i].GetEnodebID(), events[i].GetEnodebID());
+        ASSERT_EQ(decoded[i].GetMmeID(), events[i].GetMmeID());
+        ASSERT_EQ(decoded[i].GetCgi(), events[i].GetCgi());
+    }
+}
+
+TEST(S1apCodecTest, InvalidRecordsAreRejected) {
+    std::vector<Event> events;
+    for (unsigned i = 0; i < 20; ++i)
+        events.push_back(Event::CreatePaging(i, 100 + i, S1ap::Cgi{0x01}));
+
+    std::vector<std::byte> frame;
+    ASSERT_TRUE(S1apCodec::Encode(std::span<const Event>(events), frame).has_value());
+
+    // Record 3 loses its M-TMSI, record 17 gets an unknown type.
+    frame[S1apCodec::HEADER_SIZE + 24 + 3] = std::byte{S1apCodec::HAS_CGI};
+    frame[S1apCodec::HEADER_SIZE + 17] = std::byte{42};
+
+    std::vector<Event> decoded;
+    auto stats = S1apCodec::Decode(frame, decoded);
+
+    ASSERT_TRUE(stats.has_value());
+    ASSERT_EQ(stats->decoded, 18u);
+    ASSERT_EQ(stats->rejected, 2u);
+    for (const auto& event : decoded)
+        ASSERT_TRUE(event.Verify().has_value());
+
+    frame[0] = std::byte{0};
+    ASSERT_EQ(S1apCodec::Decode(frame, decoded).error(), S1apCodec::Error::BadMagic);
+}
+
+TEST(S1apCodecTest, EmptyCgiIsRejected) {
+    std::vector<Event> events;
+    for (unsigned i = 0; i < 20; ++i)
+        events.push_back(Event::CreatePathSwitchRequest(i, 100 + i, 1, S1ap::Cgi{0x01}));
+
+    std::vector<std::byte> frame;
+    ASSERT_TRUE(S1apCodec::Encode(std::span<const Event>(events), frame).has_value());
+
+    // Record 2 goes through the vector path, record 18 through the tail.
+    frame[S1apCodec::HEADER_SIZE + 48 + 2] = std::byte{0};
+    frame[S1apCodec::HEADER_SIZE + 48 + 18] = std::byte{0};
+
+    std::vector<Event> decoded;
+    auto stats = S1apCodec::Decode(frame, decoded);
+
+    ASSERT_TRUE(stats.has_value());
+    ASSERT_EQ(stats->decoded, 18u);
+    ASSERT_EQ(stats->rejected, 2u);
+
+    // Decode and Verify agree for every type that carries a CGI.
+    const std::vector<Event> empty = {Event::CreatePathSwitchRequest(1, 100, 1, S1ap::Cgi{}),
+                                      Event::CreateAttachRequestWithImsi(1, 250990000000001, 1, S1ap::Cgi{})};
+
+    frame.clear();
+    decoded.clear();
+    ASSERT_TRUE(S1apCodec::Encode(std::span<const Event>(empty), frame).has_value());
+    stats = S1apCodec::Decode(frame, decoded);
+    ASSERT_TRUE(stats.has_value());
+    ASSERT_EQ(stats->rejected, 2u);
+
+    S1apDB db;
+    for (const auto& event : empty)
+        ASSERT_EQ(db.Handle(event).error(), S1apDB::HandleError(Event::Error::BadCgi));
+}
+
+TEST(S1apCodecTest, OutsRoundTrip) {
+    std::vector<S1apOut> outs;
+    outs.emplace_back(S1apOut::Type::Reg, 1, S1ap::Cgi{0x01, 0x02});
+    outs.emplace_back(S1apOut::Type::UnReg, 2, S1ap::OCgi{});
+
+    std::vector<std::byte> frame;
+    ASSERT_TRUE(S1apCodec::Encode(std::span<const S1apOut>(outs), frame).has_value());
+
+    std::vector<Event> wrongKind;
+    ASSERT_EQ(S1apCodec::Decode(frame, wrongKind).error(), S1apCodec::Error::WrongFrameKind);
+
+    std::vector<S1apOut> decoded;
+    auto stats = S1apCodec::Decode(frame, decoded);
+
+    ASSERT_TRUE(stats.has_value());
+    ASSERT_EQ(decoded.size(), 2u);
+    ASSERT_EQ(decoded[0].GetType(), S1apOut::Type::Reg);
+    ASSERT_EQ(decoded[0].GetCgi(), outs[0].GetCgi());
+    ASSERT_EQ(decoded[1].GetImsi(), 2u);
+    ASSERT_FALSE(decoded[1].GetCgi().has_value());
+}
+
+TEST(S1apIngestTest, ReplaysFramesOverLoopback) {
+    S1apDB& db = S1apDB::GetInstance();
+    S1apIngest ingest(db);
+
+    auto socket = ingest.AddUdpSocket("127.0.0.1", 0);
+    ASSERT_TRUE(socket.has_value());
+
+    constexpr S1ap::Imsi FIRST_IMSI = 500000000;
+    std::vector<std::vector<std::byte>> datagrams(3);
+
+    for (unsigned d = 0; d < datagrams.size(); ++d) {
+        std::vector<Event> events;
+        for (unsigned i = 0; i < 100; ++i) {
+            const unsigned n = d * 100 + i;
+            events.push_back(Event::CreateAttachRequestWithImsi(n, FIRST_IMSI + n, 500000 + n, S1ap::Cgi{0x05}));
+        }
+        ASSERT_TRUE(S1apCodec::Encode(std::span<const Event>(events), datagrams[d]).has_value());
+    }
+    datagrams.back().resize(datagrams.back().size() / 2);
+
+    const int sender = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in remote{};
+    remote.sin_family = AF_INET;
+    remote.sin_port = htons(ingest.GetLocalPort(socket.value()));
+    remote.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (const auto& datagram : datagrams)
+        ASSERT_EQ(::sendto(sender, datagram.data(), datagram.size(), 0,
+                           reinterpret_cast<const sockaddr*>(&remote), sizeof(remote)),
+                  static_cast<ssize_t>(datagram.size()));
+    ::close(sender);
+
+    const auto& stats = ingest.GetStats(socket.value());
+    for (int attempt = 0; attempt < 50 && stats.datagrams < datagrams.size(); ++attempt)
+        ASSERT_TRUE(ingest.RunOnce(100).has_value());
+
+    ASSERT_EQ(stats.datagrams, 3u);
+    ASSERT_EQ(stats.events, 200u);
+    ASSERT_EQ(stats.malformedFrames, 1u);
+    ASSERT_EQ(stats.handleErrors, 0u);
+    ASSERT_TRUE(db.Lookup(FIRST_IMSI + 199).has_value());
+    ASSERT_FALSE(db.Lookup(FIRST_IMSI + 200).has_value());
+}
+
+TEST(S1apIngestTest, BusySocketDoesNotStarveOthers) {
+    S1apDB db;
+    S1apIngest ingest(db, S1apIngest::Config{.batchSize = 2, .maxBatchesPerPoll = 2});
+
+    auto busy = ingest.AddUdpSocket("127.0.0.1", 0);
+    auto quiet = ingest.AddUdpSocket("127.0.0.1", 0);
+    ASSERT_TRUE(busy.has_value() && quiet.has_value());
+
+    const int sender = ::socket(AF_INET, SOCK_DGRAM, 0);
+    auto send = [&](std::size_t socket, S1ap::Imsi imsi) {
+        std::vector<std::byte> datagram;
+        std::vector<Event> events{Event::CreateAttachRequestWithImsi(1, imsi, static_cast<S1ap::EnodebID>(imsi % 100000), S1ap::Cgi{0x05})};
+        ASSERT_TRUE(S1apCodec::Encode(std::span<const Event>(events), datagram).has_value());
+
+        sockaddr_in remote{};
+        remote.sin_family = AF_INET;
+        remote.sin_port = htons(ingest.GetLocalPort(socket));
+        remote.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ASSERT_EQ(::sendto(sender, datagram.data(), datagram.size(), 0, reinterpret_cast<const sockaddr*>(&remote), sizeof(remote)),
+                  static_cast<ssize_t>(datagram.size()));
+    };
+
+    for (S1ap::Imsi imsi = 505000000; imsi < 505000010; ++imsi)
+        send(busy.value(), imsi);
+    send(quiet.value(), 505000100);
+    ::close(sender);
+
+    // One poll round takes at most two batches of two from the busy socket.
+    ASSERT_TRUE(ingest.RunOnce(100).has_value());
+    ASSERT_EQ(ingest.GetStats(busy.value()).datagrams, 4u);
+    ASSERT_EQ(ingest.GetStats(quiet.value()).datagrams, 1u);
+
+    for (int attempt = 0; attempt < 10 && ingest.GetStats(busy.value()).datagrams < 10; ++attempt)
+        ASSERT_TRUE(ingest.RunOnce(100).has_value());
+    ASSERT_EQ(ingest.GetStats(busy.value()).events, 10u);
+}
+
+namespace {
+    struct DetachedTask {
+        struct promise_type {
+            DetachedTask get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    DetachedTask AttachAsync(S1apAsync& async, Executor& caller, S1ap::Imsi imsi, S1ap::EnodebID enodebID,
+                             std::atomic<unsigned>& registered, std::atomic<unsigned>& wrongThread, std::latch& done) {
+        S1ap::Cgi cgi = {0x06};
+        auto event = Event::CreateAttachRequestWithImsi(imsi, imsi, enodebID, cgi);
+        auto result = co_await async.HandleAsync(std::move(event), caller);
+
+        if (!caller.IsCurrent())
+            ++wrongThread;
+        if (result.has_value() && result->has_value() && result->value().GetType() == S1apOut::Type::Reg)
+            ++registered;
+
+        done.count_down();
+    }
+}
+
+TEST(S1apAsyncTest, ManyRequestsInFlightResumeOnCallerExecutor) {
+    ThreadExecutor shard;
+    ThreadExecutor caller;
+    S1apAsync async(S1apDB::GetInstance(), shard);
+
+    constexpr unsigned REQUESTS = 5000;
+    constexpr S1ap::Imsi FIRST_IMSI = 600000000;
+
+    std::atomic<unsigned> registered = 0;
+    std::atomic<unsigned> wrongThread = 0;
+    std::latch done(REQUESTS);
+
+    for (unsigned i = 0; i < REQUESTS; ++i)
+        AttachAsync(async, caller, FIRST_IMSI + i, 600000 + i, registered, wrongThread, done);
+
+    done.wait();
+
+    ASSERT_EQ(registered.load(), REQUESTS);
+    ASSERT_EQ(wrongThread.load(), 0u);
+    ASSERT_TRUE(S1apDB::GetInstance().Lookup(FIRST_IMSI + REQUESTS - 1).has_value());
+}
+
+TEST(S1apDBTest, CellAndEnodebCountsFollowTransitions) {
+    S1apDB& db = S1apDB::GetInstance();
+    S1ap::Cgi busyCell = {0x70, 0x01};
+    S1ap::Cgi quietCell = {0x70, 0x02};
+
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(70000, 700000001, 7001, busyCell)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(70001, 700000002, 7002, busyCell)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(70002, 700000003, 7003, busyCell)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(70003, 700000004, 7004, quietCell)).has_value());
+
+    ASSERT_EQ(db.GetCellCounts(busyCell).attached, 3u);
+    ASSERT_EQ(db.GetCellCounts(quietCell).attached, 1u);
+    ASSERT_EQ(db.GetEnodebCounts(7001).attached, 1u);
+
+    auto mTmsi = db.Lookup(700000002)->mTmsi.value();
+    ASSERT_TRUE(db.Handle(Event::CreatePaging(70004, mTmsi, busyCell)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateUEContextReleaseResponse(70005, 7003, 1)).has_value());
+
+    auto busy = db.GetCellCounts(busyCell);
+    ASSERT_EQ(busy.attached, 1u);
+    ASSERT_EQ(busy.idle, 1u);
+    ASSERT_EQ(busy.handover, 0u);
+    ASSERT_EQ(db.GetEnodebCounts(7003).attached, 0u);
+
+    auto top = db.GetTopCells(1);
+    ASSERT_EQ(top.size(), 1u);
+    ASSERT_GE(top[0].counts.attached, 1u);
+}
+
+TEST(CgiPoolTest, EqualCgisShareOneCellID) {
+    CgiPool pool;
+    S1ap::Cgi first = {0x52, 0xf0, 0x10, 0x00, 0x01};
+    S1ap::Cgi second = {0x52, 0xf0, 0x10, 0x00, 0x02};
+
+    auto firstID = pool.Intern(first);
+    auto secondID = pool.Intern(second);
+
+    ASSERT_NE(firstID, secondID);
+    ASSERT_EQ(pool.Intern(S1ap::Cgi(first)), firstID);
+    ASSERT_EQ(pool.Find(second), secondID);
+    ASSERT_FALSE(pool.Find(S1ap::Cgi{0x01}).has_value());
+    ASSERT_TRUE(std::ranges::equal(pool.GetCgi(secondID), second));
+
+    for (unsigned i = 0; i < 10000; ++i)
+        pool.Intern(S1ap::Cgi{static_cast<unsigned char>(i), static_cast<unsigned char>(i >> 8)});
+    ASSERT_EQ(pool.Find(first), firstID);
+    ASSERT_EQ(pool.Size(), 10002u);
+}
+
+TEST(S1apShardRouterTest, MTmsiOnlyEventsReachTheOwningShard) {
+    constexpr unsigned SHARDS = 4;
+    S1apShardRouter router(SHARDS);
+
+    std::vector<std::unique_ptr<S1apDB>> shards;
+    for (unsigned i = 0; i < SHARDS; ++i)
+        shards.push_back(std::make_unique<S1apDB>(S1apDB::ShardConfig{.shardCount = SHARDS, .shardIndex = i}));
+
+    for (S1ap::Imsi imsi = 800000000; imsi < 800000040; ++imsi) {
+        const auto enodebID = static_cast<S1ap::EnodebID>(imsi % 100000);
+        auto attach = Event::CreateAttachRequestWithImsi(1, imsi, enodebID, S1ap::Cgi{0x08});
+        const auto owner = router.Route(attach).value();
+        ASSERT_EQ(owner, router.ShardOfImsi(imsi));
+        ASSERT_TRUE(shards[owner]->Handle(attach).has_value());
+
+        const auto mTmsi = shards[owner]->Lookup(imsi)->mTmsi.value();
+        ASSERT_EQ(router.ShardOfMTmsi(mTmsi), owner);
+
+        auto paging = Event::CreatePaging(2, mTmsi, S1ap::Cgi{0x08});
+        ASSERT_EQ(router.Route(paging), owner);
+        ASSERT_TRUE(shards[owner]->Handle(paging).has_value());
+        ASSERT_EQ(shards[owner]->Lookup(imsi)->state, S1apDB::SubscriberState::PAGING_STATE);
+
+        auto misrouted = shards[(owner + 1) % SHARDS]->Handle(paging);
+        ASSERT_FALSE(misrouted.has_value());
+        ASSERT_EQ(misrouted.error(), S1apDB::HandleError(S1apDB::Error::WrongShard));
+    }
+
+    ASSERT_FALSE(router.Route(Event::CreateUEContextReleaseResponse(3, 1, 1)).has_value());
+
+    // An index outside the shard count would allocate M-TMSIs no shard owns.
+    ASSERT_THROW(S1apDB(S1apDB::ShardConfig{.shardCount = SHARDS, .shardIndex = SHARDS}), std::invalid_argument);
+    ASSERT_THROW(S1apDB(S1apDB::ShardConfig{.shardCount = 0, .shardIndex = 1}), std::invalid_argument);
+}
+
+TEST(S1apDBTest, AttachWithKnownMTmsiReattachesSubscriber) {
+    S1apDB db;
+    S1ap::Imsi imsi = 900000001;
+    S1ap::Cgi cgi = {0x09};
+
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1, imsi, 9001, cgi)).has_value());
+    const auto mTmsi = db.Lookup(imsi)->mTmsi.value();
+
+    auto duplicate = db.Handle(Event::CreateAttachRequestWithMTmsi(2, 9001, mTmsi, cgi));
+    ASSERT_TRUE(duplicate.has_value());
+    ASSERT_FALSE(duplicate->has_value());
+
+    ASSERT_TRUE(db.Handle(Event::CreatePaging(3, mTmsi, cgi)).has_value());
+    auto reattach = db.Handle(Event::CreateAttachRequestWithMTmsi(4, 9002, mTmsi, cgi));
+    ASSERT_TRUE(reattach.has_value());
+    ASSERT_EQ(reattach->value().GetImsi(), imsi);
+    ASSERT_EQ(db.Lookup(imsi)->enodebID, 9002u);
+}
+
+TEST(S1apDBTest, SnapshotRoundTripRestoresState) {
+    S1apDB db;
+    S1ap::Cgi cgi = {0x0a, 0x01};
+
+    for (S1ap::Imsi imsi = 910000000; imsi < 910000050; ++imsi)
+        ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1, imsi, static_cast<S1ap::EnodebID>(imsi % 100000), cgi)).has_value());
+
+    const auto mTmsi = db.Lookup(910000007)->mTmsi.value();
+    ASSERT_TRUE(db.Handle(Event::CreatePaging(2, mTmsi, cgi)).has_value());
+
+    auto snapshot = db.SaveSnapshot();
+    S1apDB restored;
+    ASSERT_TRUE(restored.LoadSnapshot(snapshot).has_value());
+    ASSERT_EQ(restored.SaveSnapshot(), snapshot);
+    ASSERT_EQ(restored.Lookup(910000007)->state, S1apDB::SubscriberState::PAGING_STATE);
+    ASSERT_EQ(restored.LookupByMTmsi(mTmsi)->imsi, 910000007u);
+    ASSERT_EQ(restored.GetCellCounts(cgi).attached, 49u);
+
+    // A repeated IMSI or M-TMSI is rejected before anything is replaced, so
+    // the counts do not drift. Subscribers start at 27, 35 bytes each, then
+    // the M-TMSI index, 12 bytes per entry.
+    const std::size_t firstSubscriber = 27;
+    const std::size_t firstMTmsi = firstSubscriber + 50 * 35 + 8;
+
+    auto duplicateImsi = snapshot;
+    std::copy_n(duplicateImsi.begin() + firstSubscriber, 8, duplicateImsi.begin() + firstSubscriber + 35);
+    ASSERT_FALSE(restored.LoadSnapshot(duplicateImsi).has_value());
+
+    auto duplicateMTmsi = snapshot;
+    std::copy_n(duplicateMTmsi.begin() + firstMTmsi, 4, duplicateMTmsi.begin() + firstMTmsi + 12);
+    ASSERT_FALSE(restored.LoadSnapshot(duplicateMTmsi).has_value());
+
+    ASSERT_EQ(restored.SaveSnapshot(), snapshot);
+    ASSERT_EQ(restored.GetCellCounts(cgi).attached, 49u);
+
+    snapshot[snapshot.size() / 2] ^= std::byte{0xff};
+    snapshot.resize(snapshot.size() - 1);
+    ASSERT_FALSE(restored.LoadSnapshot(snapshot).has_value());
+}
+
+TEST(S1apDBTest, BulkImportRebuildsIndexes) {
+    S1apDB db;
+    S1ap::Cgi cgi = {0x0c, 0x02};
+
+    for (S1ap::Imsi imsi = 915000000; imsi < 915000050; ++imsi)
+        ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1, imsi, static_cast<S1ap::EnodebID>(imsi % 100000), cgi)).has_value());
+
+    const auto mTmsi = db.Lookup(915000007)->mTmsi.value();
+    ASSERT_TRUE(db.Handle(Event::CreatePaging(2, mTmsi, cgi)).has_value());
+
+    auto bulk = db.ExportSubscribers();
+    S1apDB imported;
+    ASSERT_EQ(imported.ImportSubscribers(bulk).value(), 50u);
+    ASSERT_EQ(imported.Lookup(915000007)->state, S1apDB::SubscriberState::PAGING_STATE);
+    ASSERT_EQ(imported.Lookup(915000007)->cgi, cgi);
+    ASSERT_EQ(imported.LookupByMTmsi(mTmsi)->imsi, 915000007u);
+    ASSERT_EQ(imported.GetCellCounts(cgi).attached, 49u);
+
+    // Imported contexts take part in the state machine like any other.
+    ASSERT_TRUE(imported.Handle(Event::CreatePathSwitchRequest(3, 3, 1, S1ap::Cgi{0x7f})).has_value());
+    ASSERT_EQ(imported.Lookup(915000003)->state, S1apDB::SubscriberState::HANDOVER_STATE);
+    ASSERT_TRUE(imported.Handle(Event::CreateAttachRequestWithImsi(4, 915000100, 100, cgi)).has_value());
+    ASSERT_GT(imported.Lookup(915000100)->mTmsi.value(), mTmsi);
+
+    // The same IMSI twice is rejected and the live state is kept.
+    const auto before = imported.SaveSnapshot();
+    const std::size_t imsiColumn = 32;
+    auto duplicateImsi = bulk;
+    std::copy_n(duplicateImsi.begin() + imsiColumn, 8, duplicateImsi.begin() + imsiColumn + 8);
+    ASSERT_FALSE(imported.ImportSubscribers(duplicateImsi).has_value());
+    ASSERT_EQ(imported.Lookup(915000007)->state, S1apDB::SubscriberState::PAGING_STATE);
+    ASSERT_EQ(imported.LookupByMTmsi(mTmsi)->imsi, 915000007u);
+    ASSERT_TRUE(imported.Lookup(915000100).has_value());
+    ASSERT_EQ(imported.SaveSnapshot(), before);
+
+    // So is the same M-TMSI twice.
+    const std::size_t mTmsiColumn = imsiColumn + 50 * 8;
+    auto duplicateMTmsi = bulk;
+    std::copy_n(duplicateMTmsi.begin() + mTmsiColumn, 4, duplicateMTmsi.begin() + mTmsiColumn + 4);
+    ASSERT_FALSE(imported.ImportSubscribers(duplicateMTmsi).has_value());
+    ASSERT_EQ(imported.SaveSnapshot(), before);
+
+    bulk.resize(bulk.size() - 1);
+    ASSERT_FALSE(imported.ImportSubscribers(bulk).has_value());
+}
+
+TEST(S1apDBTest, BulkImportKeepsEnodebIndex) {
+    S1apDB db;
+    S1ap::Cgi cgi = {0x0c, 0x03};
+
+    // A later attach on the same eNodeB takes the index entry over.
+    for (S1ap::Imsi k = 0; k < 20; ++k) {
+        const auto enodebID = static_cast<S1ap::EnodebID>(100 + k);
+        ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1, 918000000 + k, enodebID, cgi)).has_value());
+        ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(2, 918000100 + k, enodebID, cgi)).has_value());
+    }
+
+    S1apDB imported;
+    ASSERT_EQ(imported.ImportSubscribers(db.ExportSubscribers()).value(), 40u);
+
+    for (S1ap::Imsi k = 0; k < 20; ++k) {
+        ASSERT_TRUE(imported.Handle(Event::CreateUEContextReleaseResponse(3, static_cast<S1ap::EnodebID>(100 + k), 1)).has_value());
+        ASSERT_FALSE(imported.Lookup(918000100 + k).has_value());
+        ASSERT_TRUE(imported.Lookup(918000000 + k).has_value());
+    }
+}
+
+TEST(S1apDBTest, AdmissionShedsLowPriorityEventsOverBudget) {
+    S1apDB db;
+    S1ap::Cgi cgi = {0x0e};
+    const auto overloaded = S1apDB::HandleError(S1apDB::Error::Overloaded);
+
+    db.SetAdmissionConfig({.globalEventsPerSecond = 2, .enodebEventsPerSecond = 0, .burstSeconds = 1});
+
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1000, 916000001, 1, cgi)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1000, 916000002, 2, cgi)).has_value());
+    const auto mTmsi = db.Lookup(916000001)->mTmsi.value();
+
+    // Budget spent: paging and a duplicate attach are shed, a new attach is not.
+    ASSERT_EQ(db.Handle(Event::CreatePaging(1000, mTmsi, cgi)).error(), overloaded);
+    ASSERT_EQ(db.Handle(Event::CreateAttachRequestWithImsi(1000, 916000002, 2, cgi)).error(), overloaded);
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1000, 916000003, 3, cgi)).has_value());
+    ASSERT_EQ(db.Lookup(916000001)->state, S1apDB::SubscriberState::ATTACHED);
+
+    const auto& stats = db.GetAdmissionStats();
+    ASSERT_EQ(stats.shedPaging, 1u);
+    ASSERT_EQ(stats.shedDuplicateAttach, 1u);
+    ASSERT_EQ(stats.overBudget, 3u);
+
+    // A second later the bucket has refilled.
+    ASSERT_TRUE(db.Handle(Event::CreatePaging(2000, mTmsi, cgi)).has_value());
+    ASSERT_EQ(db.Lookup(916000001)->state, S1apDB::SubscriberState::PAGING_STATE);
+
+    // One noisy eNodeB does not eat the budget of the others.
+    db.SetAdmissionConfig({.globalEventsPerSecond = 0, .enodebEventsPerSecond = 1, .burstSeconds = 1});
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(3000, 916000003, 3, cgi)).has_value());
+    ASSERT_EQ(db.Handle(Event::CreateAttachRequestWithImsi(3000, 916000003, 3, cgi)).error(), overloaded);
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(3000, 916000002, 2, cgi)).has_value());
+}
+
+TEST(S1apDBTest, AdmissionChargesEnodebOnlyAfterGlobalBudget) {
+    S1apDB db;
+    S1ap::Cgi cgi = {0x0e, 0x01};
+    const auto overloaded = S1apDB::HandleError(S1apDB::Error::Overloaded);
+    const auto& stats = db.GetAdmissionStats();
+
+    // Two events of global budget, one per eNodeB, refilled at half the rate.
+    db.SetAdmissionConfig({.globalEventsPerSecond = 1, .enodebEventsPerSecond = 0.5, .burstSeconds = 2});
+
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1000, 916100001, 7, cgi)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1000, 916100002, 8, cgi)).has_value());
+    ASSERT_EQ(db.Handle(Event::CreateAttachRequestWithImsi(1000, 916100002, 9, cgi)).error(), overloaded);
+    ASSERT_EQ(stats.overBudget, 1u);
+
+    // eNodeB 9 kept its token while the global bucket turned it away.
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(2000, 916100003, 9, cgi)).has_value());
+    ASSERT_EQ(stats.overBudget, 1u);
+}
+
+TEST(S1apDBTest, AdmissionBoundsEnodebBuckets) {
+    S1apDB db;
+    const auto& stats = db.GetAdmissionStats();
+
+    db.SetAdmissionConfig({.globalEventsPerSecond = 0, .enodebEventsPerSecond = 1, .burstSeconds = 1});
+
+    // Fills every bucket slot with an eNodeB that has spent its budget.
+    for (S1ap::EnodebID enodebID = 0; enodebID < (1u << 16); ++enodebID)
+        db.Handle(Event::CreatePathSwitchRequestAcknowledge(1000, enodebID, 1));
+
+    ASSERT_EQ(stats.overBudget, 0u);
+
+    // No room: a new eNodeB is only held to the global budget.
+    db.Handle(Event::CreatePathSwitchRequestAcknowledge(1000, 70000, 1));
+    db.Handle(Event::CreatePathSwitchRequestAcknowledge(1000, 70000, 1));
+    ASSERT_EQ(stats.overBudget, 0u);
+
+    // Once the old buckets refilled they are forgotten and new ones fit.
+    db.Handle(Event::CreatePathSwitchRequestAcknowledge(2000, 70001, 1));
+    db.Handle(Event::CreatePathSwitchRequestAcknowledge(2000, 70001, 1));
+    ASSERT_EQ(stats.overBudget, 1u);
+
+    db.Handle(Event::CreatePathSwitchRequestAcknowledge(2000, 1, 1));
+    ASSERT_EQ(stats.overBudget, 1u);
+}
+
+TEST(S1apDBTest, TraceKeepsLastEventsOfWatchedSubscribers) {
+    using State = S1apDB::SubscriberState;
+
+    S1apDB db;
+    S1ap::Cgi cgi = {0x0f};
+    const S1ap::Imsi watched = 917000001;
+
+    db.SetTraceConfig({.watchlist = {watched}, .sampleOneIn = 0});
+
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1, watched, 1, cgi)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1, 917000002, 2, cgi)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1, watched, 1, cgi)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(2, watched, 1, cgi)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreatePaging(3, db.Lookup(watched)->mTmsi.value(), cgi)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateUEContextReleaseResponse(4, 1, 1)).has_value());
+
+    // One entry per event, even for repeats with the same timestamp, and
+    // still there after the detach removed the record.
+    auto trace = db.GetTrace(watched);
+    ASSERT_EQ(trace.size(), 5u);
+    ASSERT_EQ(trace[0].oldState, State::DETACHED);
+    ASSERT_EQ(trace[0].newState, State::ATTACHED);
+    ASSERT_EQ(trace[1].timestamp, 1u);
+    ASSERT_EQ(trace[1].oldState, State::ATTACHED);
+    ASSERT_EQ(trace[1].newState, State::ATTACHED);
+    ASSERT_EQ(trace[2].timestamp, 2u);
+    ASSERT_EQ(trace[2].oldState, State::ATTACHED);
+    ASSERT_EQ(trace[2].newState, State::ATTACHED);
+    ASSERT_EQ(trace[3].cause, Event::Type::Paging);
+    ASSERT_EQ(trace[3].oldState, State::ATTACHED);
+    ASSERT_EQ(trace[3].newState, State::PAGING_STATE);
+    ASSERT_EQ(trace[4].cause, Event::Type::UEContextReleaseResponse);
+    ASSERT_EQ(trace[4].newState, State::DETACHED);
+    ASSERT_TRUE(db.GetTrace(917000002).empty());
+
+    // The ring keeps the latest TRACE_DEPTH events across re-attach.
+    for (S1ap::Timestamp t = 10; t < 10 + S1apDB::TRACE_DEPTH; ++t)
+        ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(t, watched, 1, cgi)).has_value());
+
+    trace = db.GetTrace(watched);
+    ASSERT_EQ(trace.size(), S1apDB::TRACE_DEPTH);
+    ASSERT_EQ(trace.front().timestamp, 10u);
+    ASSERT_EQ(trace.back().timestamp, 9 + S1apDB::TRACE_DEPTH);
+
+    // Sampling everyone picks up subscribers that already exist and keeps
+    // the rings already running.
+    db.SetTraceConfig({.watchlist = {watched}, .sampleOneIn = 1});
+    ASSERT_EQ(db.GetTrace(watched).size(), S1apDB::TRACE_DEPTH);
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(40, 917000002, 2, cgi)).has_value());
+    ASSERT_EQ(db.GetTrace(917000002).size(), 1u);
+
+    // Only watchlisted rings outlive a detach, so churn cannot pile them up.
+    ASSERT_TRUE(db.Handle(Event::CreateUEContextReleaseResponse(41, 2, 1)).has_value());
+    ASSERT_TRUE(db.Handle(Event::CreateUEContextReleaseResponse(42, 1, 1)).has_value());
+    ASSERT_TRUE(db.GetTrace(917000002).empty());
+    ASSERT_EQ(db.GetTrace(watched).back().timestamp, 42u);
+
+    ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(43, 917000002, 2, cgi)).has_value());
+    ASSERT_EQ(db.GetTrace(917000002).size(), 1u);
+}
+
+TEST(S1apReplicationTest, EndpointParseRejectsBadPorts) {
+    using S1apReplication::Endpoint;
+    using S1apReplication::Error;
+
+    ASSERT_EQ(Endpoint::Parse("127.0.0.1:65535")->port, 65535u);
+    ASSERT_EQ(Endpoint::Parse("unix:/tmp/s1ap.sock")->unixPath, "/tmp/s1ap.sock");
+
+    for (const char* address : {"127.0.0.1:65536", "127.0.0.1:70000", "127.0.0.1:http", "127.0.0.1:80x",
+                                "127.0.0.1:-1", "127.0.0.1:", "127.0.0.1", "unix:"})
+        ASSERT_EQ(Endpoint::Parse(address).error(), Error::BadAddress) << address;
+}
+
+TEST(S1apReplicationTest, StandbyCatchesUpWithPrimary) {
+    S1apDB primaryDB;
+    S1apDB standbyDB;
+    S1ap::Cgi cgi = {0x0b};
+
+    S1apReplicaPrimary primary(primaryDB, S1apReplicaPrimary::Config{.flushInterval = std::chrono::milliseconds(1)});
+    ASSERT_TRUE(primary.Listen(S1apReplication::Endpoint::Parse("127.0.0.1:0").value()).has_value());
+
+    // State that only the snapshot carries.
+    for (S1ap::Imsi imsi = 920000000; imsi < 920000100; ++imsi)
+        ASSERT_TRUE(primary.Handle(Event::CreateAttachRequestWithImsi(1, imsi, static_cast<S1ap::EnodebID>(imsi % 100000), cgi)).has_value());
+
+    auto endpoint = S1apReplication::Endpoint::Parse("127.0.0.1:" + std::to_string(primary.GetLocalPort())).value();
+    S1apReplicaStandby standby(standbyDB);
+    ASSERT_TRUE(standby.Connect(endpoint).has_value());
+
+    std::atomic<bool> stop{false};
+    std::thread applier([&] { ASSERT_TRUE(standby.Run(stop).has_value()); });
+
+    while (!primary.HasStandby()) {
+        primary.Service();
+        std::this_thread::yield();
+    }
+
+    // The log tail, including events the primary rejects.
+    for (S1ap::Imsi imsi = 920000000; imsi < 920000100; ++imsi) {
+        const auto mTmsi = primaryDB.Lookup(imsi)->mTmsi.value();
+        primary.Handle(Event::CreatePaging(2, mTmsi, cgi));
+        primary.Handle(Event::CreateAttachRequestWithImsi(3, imsi + 1000, static_cast<S1ap::EnodebID>(imsi % 100000 + 1000), cgi));
+    }
+    ASSERT_FALSE(primary.Handle(Event::CreatePathSwitchRequest(4, 99999, 1, cgi)).has_value());
+
+    while (standby.GetAppliedSequence() != primary.GetSequence())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    stop = true;
+    applier.join();
+
+    ASSERT_EQ(primary.GetResyncCount(), 1u);
+    ASSERT_EQ(standbyDB.SaveSnapshot(), primaryDB.SaveSnapshot());
+    ASSERT_EQ(standbyDB.Lookup(920000042)->state, S1apDB::SubscriberState::PAGING_STATE);
+}
+
+TEST(S1apReplicationTest, LaggingStandbyIsResyncedNotPromoted) {
+    S1apDB primaryDB;
+    S1apDB standbyDB;
+    S1ap::Cgi cgi = {0x0d};
+
+    S1apReplicaPrimary primary(primaryDB, S1apReplicaPrimary::Config{.flushInterval = std::chrono::milliseconds(200),
+                                                                      .maxBatch = 1024,
+                                                                      .maxBacklog = 8});
+    ASSERT_TRUE(primary.Listen(S1apReplication::Endpoint::Parse("127.0.0.1:0").value()).has_value());
+
+    auto endpoint = S1apReplication::Endpoint::Parse("127.0.0.1:" + std::to_string(primary.GetLocalPort())).value();
+    S1apReplicaStandby standby(standbyDB);
+    ASSERT_TRUE(standby.Connect(endpoint).has_value());
+
+    std::atomic<bool> stop{false};
+    std::expected<void, S1apReplication::Error> result;
+    std::thread applier([&] { result = standby.Run(stop); });
+
+    while (!primary.HasStandby()) {
+        primary.Service();
+        std::this_thread::yield();
+    }
+
+    // Overruns the backlog long before the next flush.
+    for (S1ap::Imsi imsi = 921000000; imsi < 921000032; ++imsi)
+        ASSERT_TRUE(primary.Handle(Event::CreateAttachRequestWithImsi(1, imsi, static_cast<S1ap::EnodebID>(imsi % 100000), cgi)).has_value());
+
+    // The standby comes back for a fresh snapshot instead of taking over.
+    for (int attempt = 0; attempt < 5000; ++attempt) {
+        if (standby.GetResyncCount() != 0 && primary.HasStandby() && standby.GetAppliedSequence() == primary.GetSequence())
+            break;
+        primary.Service();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    stop = true;
+    applier.join();
+
+    // A quick reconnect may land mid-burst and be dropped once more.
+    ASSERT_TRUE(result.has_value());
+    ASSERT_GE(standby.GetResyncCount(), 1u);
+    ASSERT_EQ(primary.GetResyncCount(), standby.GetResyncCount() + 1);
+    ASSERT_EQ(standbyDB.SaveSnapshot(), primaryDB.SaveSnapshot());
+}
+
+TEST(S1apReplicationTest, UnencodableCgiIsRejectedBeforeReplication) {
+    S1apDB primaryDB;
+    S1apDB standbyDB;
+    S1ap::Cgi cgi = {0x0e};
+
+    S1apReplicaPrimary primary(primaryDB, S1apReplicaPrimary::Config{.flushInterval = std::chrono::milliseconds(1)});
+    ASSERT_TRUE(primary.Listen(S1apReplication::Endpoint::Parse("127.0.0.1:0").value()).has_value());
+
+    auto endpoint = S1apReplication::Endpoint::Parse("127.0.0.1:" + std::to_string(primary.GetLocalPort())).value();
+    S1apReplicaStandby standby(standbyDB);
+    ASSERT_TRUE(standby.Connect(endpoint).has_value());
+
+    std::atomic<bool> stop{false};
+    std::expected<void, S1apReplication::Error> result;
+    std::thread applier([&] { result = standby.Run(stop); });
+
+    while (!primary.HasStandby()) {
+        primary.Service();
+        std::this_thread::yield();
+    }
+
+    ASSERT_TRUE(primary.Handle(Event::CreateAttachRequestWithImsi(1, 922000001, 1, cgi)).has_value());
+
+    const S1ap::Cgi longCgi(Event::MAX_CGI_SIZE + 1, 0x0e);
+    const S1ap::Cgi snapshotBreakingCgi(300, 0x0e);
+
+    ASSERT_EQ(primary.Handle(Event::CreateAttachRequestWithImsi(2, 922000002, 2, longCgi)).error(),
+              S1apDB::HandleError(Event::Error::BadCgi));
+    ASSERT_EQ(primary.Handle(Event::CreateAttachRequestWithImsi(3, 922000003, 3, snapshotBreakingCgi)).error(),
+              S1apDB::HandleError(Event::Error::BadCgi));
+
+    ASSERT_EQ(primary.Handle(Event::CreateAttachRequestWithImsi(3, 922000005, 5, S1ap::Cgi{})).error(),
+              S1apDB::HandleError(Event::Error::BadCgi));
+
+    const S1ap::Cgi longestCgi(Event::MAX_CGI_SIZE, 0x0e);
+    ASSERT_TRUE(primary.Handle(Event::CreateAttachRequestWithImsi(4, 922000004, 4, longestCgi)).has_value());
+
+    while (standby.GetAppliedSequence() != primary.GetSequence())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    stop = true;
+    applier.join();
+
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(primary.GetResyncCount(), 1u);
+    ASSERT_FALSE(standbyDB.Lookup(922000002).has_value());
+    ASSERT_FALSE(standbyDB.Lookup(922000003).has_value());
+    ASSERT_FALSE(standbyDB.Lookup(922000005).has_value());
+    ASSERT_TRUE(standbyDB.Lookup(922000004).has_value());
+
+    S1apDB restored;
+    ASSERT_TRUE(restored.LoadSnapshot(primaryDB.SaveSnapshot()).has_value());
+    ASSERT_EQ(standbyDB.SaveSnapshot(), primaryDB.SaveSnapshot());
+}
+
+TEST(HugePageResourceTest, SubscriberStoreFallsBackWithoutReservedPages) {
+    HugePageResource::Config config{};
+    config.pageSize = HugePageResource::PageSize::Huge2M;
+    config.numaNode = 0;
+
+    S1apDB db(S1apDB::ShardConfig{}, config);
+    S1ap::Cgi cgi = {0x0c};
+
+    for (S1ap::Imsi imsi = 930000000; imsi < 930020000; ++imsi)
+        ASSERT_TRUE(db.Handle(Event::CreateAttachRequestWithImsi(1, imsi, static_cast<S1ap::EnodebID>(imsi % 100000), cgi)).has_value());
+
+    ASSERT_EQ(db.Lookup(930012345)->state, S1apDB::SubscriberState::ATTACHED);
+
+    // Whichever kind of page backed it, every mapping is whole 2MB pages.
+    const auto stats = db.GetMemoryStats();
+    ASSERT_GT(stats.mappings, 0u);
+    ASSERT_EQ((stats.hugeTlbBytes + stats.transparentBytes) % (2u << 20), 0u);
+    ASSERT_GE(stats.hugeTlbBytes + stats.transparentBytes, stats.mappings * (2u << 20));
+    ASSERT_EQ(S1apDB{}.GetMemoryStats().mappings, 0u);
+}
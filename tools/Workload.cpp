@@ -0,0 +1,45 @@
+#include "Workload.hpp"
+
+#include <random>
+
+std::vector<Event> GenerateWorkload(const WorkloadConfig& config)
+{
+  std::mt19937_64 random(config.seed);
+  std::uniform_int_distribution<std::size_t> pickSubscriber(0, config.subscribers - 1);
+  std::uniform_int_distribution<int> pickAction(0, 99);
+
+  std::vector<bool> attached(config.subscribers, false);
+  std::vector<Event> events;
+  events.reserve(config.events);
+
+  constexpr S1ap::MmeID MME_ID = 1;
+  S1ap::Timestamp timestamp = 0;
+
+  while (events.size() < config.events)
+  {
+    const auto index = pickSubscriber(random);
+    const auto imsi = config.firstImsi + index;
+    const auto enodebID = static_cast<S1ap::EnodebID>(index + 1);
+    S1ap::Cgi cgi = {0x52, 0xf0, 0x10, static_cast<unsigned char>(index >> 16),
+                     static_cast<unsigned char>(index >> 8), static_cast<unsigned char>(index & 0xff), 0x01};
+
+    ++timestamp;
+
+    if (!attached[index])
+    {
+      events.push_back(Event::CreateAttachRequestWithImsi(timestamp, imsi, enodebID, std::move(cgi)));
+      attached[index] = true;
+    }
+    else if (pickAction(random) < 20)
+    {
+      events.push_back(Event::CreateAttachRequestWithImsi(timestamp, imsi, enodebID, std::move(cgi)));
+    }
+    else
+    {
+      events.push_back(Event::CreateUEContextReleaseResponse(timestamp, enodebID, MME_ID));
+      attached[index] = false;
+    }
+  }
+
+  return events;
+}
@@ -0,0 +1,24 @@
+#ifndef WORKLOAD_HPP
+#define WORKLOAD_HPP
+
+#include "S1apDB.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Seeded attach / re-attach / release traffic for replay and benchmarks.
+// Every subscriber gets its own eNodeB ID, so the stream is valid for a
+// fresh S1apDB no matter how it is split into frames. subscribers must not
+// be zero.
+struct WorkloadConfig
+{
+  std::uint64_t seed = 1;
+  std::size_t subscribers = 10000;
+  std::size_t events = 1000000;
+  S1ap::Imsi firstImsi = 250010000000000;
+};
+
+std::vector<Event> GenerateWorkload(const WorkloadConfig& config);
+
+#endif // WORKLOAD_HPP
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Builds s1ap_bench in the release, release-lto, native and PGO presets and
+# prints a table of events/s. Arguments are passed to s1ap_bench.
+set -e
+
+cd "$(dirname "$0")/.."
+
+if [ $# -eq 0 ]; then
+  set -- --events 1000000 --repeat 5
+fi
+
+bench() {
+  dir=$1
+  shift
+  "build/$dir/tools/s1ap_bench" "$@" 2>&1 >/dev/null | sed -n 's/.*median \([0-9]*\) events.*/\1/p'
+}
+
+build() {
+  cmake --preset "$1" >/dev/null
+  cmake --build --preset "$1" --target "$2" >/dev/null
+}
+
+results=""
+
+for preset in release release-lto native; do
+  build "$preset" s1ap_bench
+  results="$results$preset $(bench "$preset" "$@")
+"
+done
+
+build pgo-generate pgo_train
+build pgo-use s1ap_bench
+results="${results}pgo $(bench pgo "$@")
+"
+
+printf '%s' "$results" | awk '
+  NR == 1 { base = $2 }
+  { printf "%-12s %12d events/s  %6.2fx\n", $1, $2, $2 / base }
+'
@@ -0,0 +1,250 @@
+#include "Workload.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <print>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+  void PrintUsage()
+  {
+    std::println(stderr, "usage: s1ap_bench [--events N] [--subscribers N] [--seed N] [--repeat N]\n"
+                         "                  [--lookups N] [--hugepages off|thp|2m|1g] [--numa-node N]\n"
+                         "                  [--bulk N]");
+  }
+
+  // dTLB load misses of this thread, when perf events are allowed.
+  class TlbMissCounter
+  {
+    public:
+      TlbMissCounter()
+      {
+        perf_event_attr attr{};
+
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        fd_ = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+      }
+
+      ~TlbMissCounter()
+      {
+        if (fd_ >= 0)
+          ::close(fd_);
+      }
+
+      void Start()
+      {
+        if (fd_ < 0)
+          return;
+
+        ::ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+      }
+
+      std::optional<std::uint64_t> Stop()
+      {
+        std::uint64_t count = 0;
+
+        if (fd_ < 0)
+          return std::nullopt;
+
+        ::ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        if (::read(fd_, &count, sizeof(count)) != sizeof(count))
+          return std::nullopt;
+
+        return count;
+      }
+
+    private:
+      int fd_ = -1;
+  };
+
+  std::string FormatMisses(std::optional<std::uint64_t> misses)
+  {
+    return misses.has_value() ? std::to_string(misses.value()) : "n/a";
+  }
+}
+
+// Feeds a seeded workload straight into S1apDB::Handle(), without sockets,
+// and reports events/s. S1apDB logs every event to stdout, so run it with
+// stdout redirected; the results go to stderr. Also the PGO training run.
+int main(int argc, char** argv)
+{
+  WorkloadConfig workload{};
+  std::size_t repeat = 3;
+  std::size_t lookups = 0;
+  std::size_t bulkRounds = 0;
+  std::optional<HugePageResource::Config> memory;
+
+  // std::stoul and friends throw on garbage and on overflow.
+  try
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      const std::string_view arg = argv[i];
+
+      if (i + 1 >= argc)
+      {
+        PrintUsage();
+        return 1;
+      }
+
+      if (arg == "--events")
+        workload.events = std::stoul(argv[++i]);
+      else if (arg == "--subscribers")
+        workload.subscribers = std::stoul(argv[++i]);
+      else if (arg == "--seed")
+        workload.seed = std::stoull(argv[++i]);
+      else if (arg == "--repeat")
+        repeat = std::max<std::size_t>(1, std::stoul(argv[++i]));
+      else if (arg == "--lookups")
+        lookups = std::stoul(argv[++i]);
+      else if (arg == "--hugepages")
+      {
+        const std::string_view pages = argv[++i];
+
+        if (pages == "off")
+          memory.reset();
+        else if (pages == "thp")
+          memory = HugePageResource::Config{.pageSize = HugePageResource::PageSize::Transparent};
+        else if (pages == "2m")
+          memory = HugePageResource::Config{.pageSize = HugePageResource::PageSize::Huge2M};
+        else if (pages == "1g")
+          memory = HugePageResource::Config{.pageSize = HugePageResource::PageSize::Huge1G};
+        else
+        {
+          PrintUsage();
+          return 1;
+        }
+      }
+      else if (arg == "--bulk")
+        bulkRounds = std::stoul(argv[++i]);
+      else if (arg == "--numa-node")
+      {
+        if (!memory.has_value())
+          memory = HugePageResource::Config{};
+
+        memory->numaNode = std::stoi(argv[++i]);
+      }
+      else
+      {
+        PrintUsage();
+        return 1;
+      }
+    }
+  }
+  catch (const std::logic_error&)
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  if (workload.subscribers == 0)
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  const auto events = GenerateWorkload(workload);
+  std::vector<double> rates;
+  std::vector<double> lookupRates;
+  TlbMissCounter tlbMisses;
+
+  for (std::size_t run = 0; run < repeat; ++run)
+  {
+    auto db = memory.has_value() ? std::make_unique<S1apDB>(S1apDB::ShardConfig{}, memory.value())
+                                 : std::make_unique<S1apDB>();
+    std::size_t errors = 0;
+
+    tlbMisses.Start();
+    const auto start = std::chrono::steady_clock::now();
+
+    for (const auto& event : events)
+      if (!db->Handle(event).has_value())
+        ++errors;
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const auto handleMisses = tlbMisses.Stop();
+    rates.push_back(events.size() / elapsed.count());
+
+    std::println(stderr, "s1ap_bench: run {}: {} events in {:.3f} s, {:.0f} events/s, {} errors, {} dTLB misses",
+                 run + 1, events.size(), elapsed.count(), rates.back(), errors, FormatMisses(handleMisses));
+
+    if (memory.has_value())
+    {
+      const auto stats = db->GetMemoryStats();
+      std::println(stderr, "s1ap_bench: run {}: {} MiB on hugetlbfs pages, {} MiB on THP, NUMA node {}",
+                   run + 1, stats.hugeTlbBytes >> 20, stats.transparentBytes >> 20, stats.numaNode);
+    }
+
+    // Export the resulting store and import it into fresh instances.
+    for (std::size_t round = 0; round < bulkRounds; ++round)
+    {
+      const auto exportStart = std::chrono::steady_clock::now();
+      const auto bulk = db->ExportSubscribers();
+      const std::chrono::duration<double> exportElapsed = std::chrono::steady_clock::now() - exportStart;
+
+      auto imported = memory.has_value() ? std::make_unique<S1apDB>(S1apDB::ShardConfig{}, memory.value())
+                                         : std::make_unique<S1apDB>();
+
+      const auto importStart = std::chrono::steady_clock::now();
+      const auto count = imported->ImportSubscribers(bulk);
+      const std::chrono::duration<double> importElapsed = std::chrono::steady_clock::now() - importStart;
+
+      std::println(stderr, "s1ap_bench: run {}: bulk {} subscribers, {} MiB, export {:.3f} s, import {:.3f} s{}",
+                   run + 1, count.value_or(0), bulk.size() >> 20, exportElapsed.count(), importElapsed.count(),
+                   count.has_value() ? "" : " (rejected)");
+    }
+
+    if (lookups == 0)
+      continue;
+
+    // Random reads across the whole store, the case huge pages are for.
+    std::mt19937_64 random(workload.seed);
+    std::uniform_int_distribution<std::size_t> pick(0, workload.subscribers - 1);
+    std::size_t found = 0;
+
+    tlbMisses.Start();
+    const auto lookupStart = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < lookups; ++i)
+      found += db->Lookup(workload.firstImsi + pick(random)).has_value();
+
+    const std::chrono::duration<double> lookupElapsed = std::chrono::steady_clock::now() - lookupStart;
+    const auto lookupMisses = tlbMisses.Stop();
+    lookupRates.push_back(lookups / lookupElapsed.count());
+
+    std::println(stderr, "s1ap_bench: run {}: {} lookups ({} found), {:.0f} lookups/s, {} dTLB misses",
+                 run + 1, lookups, found, lookupRates.back(), FormatMisses(lookupMisses));
+  }
+
+  std::ranges::sort(rates);
+  std::println(stderr, "s1ap_bench: median {:.0f} events/s", rates[rates.size() / 2]);
+
+  if (!lookupRates.empty())
+  {
+    std::ranges::sort(lookupRates);
+    std::println(stderr, "s1ap_bench: median {:.0f} lookups/s", lookupRates[lookupRates.size() / 2]);
+  }
+
+  return 0;
+}
@@ -0,0 +1,242 @@
+#include "S1apIngest.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iterator>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace
+{
+  std::atomic<bool> stop = false;
+  std::atomic<bool> dumpTraces = false;
+
+  void OnSignal(int) { stop = true; }
+  void OnDumpSignal(int) { dumpTraces = true; }
+
+  void PrintUsage()
+  {
+    std::println(stderr, "usage: s1ap_ingestd [--udp HOST:PORT]... [--unix PATH]... [--batch N] [--import FILE] [--export FILE]\n"
+                         "                    [--global-rate EVENTS_PER_S] [--enodeb-rate EVENTS_PER_S]\n"
+                         "                    [--trace IMSI]... [--trace-sample N]");
+  }
+
+  bool ReadFile(const std::string& path, std::vector<std::byte>& bytes)
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      return false;
+
+    in.seekg(0, std::ios::end);
+    bytes.resize(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0);
+
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())));
+  }
+
+  bool WriteFile(const std::string& path, const std::vector<std::byte>& bytes)
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+
+    return static_cast<bool>(out.flush());
+  }
+}
+
+int main(int argc, char** argv)
+{
+  S1apIngest::Config config{};
+  std::vector<std::string> udpEndpoints;
+  std::vector<std::string> unixEndpoints;
+  std::string importPath;
+  std::string exportPath;
+  S1apDB::AdmissionConfig admission{};
+  S1apDB::TraceConfig trace{};
+
+  // std::stoul and friends throw on garbage and on overflow.
+  try
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      const std::string_view arg = argv[i];
+
+      if (i + 1 >= argc)
+      {
+        PrintUsage();
+        return 1;
+      }
+
+      if (arg == "--udp")
+        udpEndpoints.emplace_back(argv[++i]);
+      else if (arg == "--unix")
+        unixEndpoints.emplace_back(argv[++i]);
+      else if (arg == "--batch")
+        config.batchSize = std::stoul(argv[++i]);
+      else if (arg == "--import")
+        importPath = argv[++i];
+      else if (arg == "--export")
+        exportPath = argv[++i];
+      else if (arg == "--global-rate")
+        admission.globalEventsPerSecond = std::stod(argv[++i]);
+      else if (arg == "--enodeb-rate")
+        admission.enodebEventsPerSecond = std::stod(argv[++i]);
+      else if (arg == "--trace")
+        trace.watchlist.push_back(std::stoul(argv[++i]));
+      else if (arg == "--trace-sample")
+        trace.sampleOneIn = static_cast<unsigned>(std::stoul(argv[++i]));
+      else
+      {
+        PrintUsage();
+        return 1;
+      }
+    }
+  }
+  catch (const std::logic_error&)
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  if (udpEndpoints.empty() && unixEndpoints.empty())
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  if (!importPath.empty())
+  {
+    std::vector<std::byte> bulk;
+    if (!ReadFile(importPath, bulk))
+    {
+      std::println(stderr, "s1ap_ingestd: cannot read {}", importPath);
+      return 1;
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    const auto imported = S1apDB::GetInstance().ImportSubscribers(bulk);
+
+    if (!imported.has_value())
+    {
+      std::println(stderr, "s1ap_ingestd: {} is not a valid subscriber export", importPath);
+      return 1;
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+    std::println(stderr, "s1ap_ingestd: imported {} subscribers in {:.2f} s", imported.value(), elapsed.count());
+  }
+
+  S1apDB::GetInstance().SetAdmissionConfig(admission);
+  S1apDB::GetInstance().SetTraceConfig(trace);
+  S1apIngest ingest(S1apDB::GetInstance(), config);
+
+  for (const auto& endpoint : udpEndpoints)
+  {
+    const auto colon = endpoint.rfind(':');
+    if (colon == std::string::npos)
+    {
+      std::println(stderr, "s1ap_ingestd: bad UDP endpoint {}", endpoint);
+      return 1;
+    }
+
+    unsigned long port = 0;
+    try
+    {
+      port = std::stoul(endpoint.substr(colon + 1));
+    }
+    catch (const std::logic_error&)
+    {
+      port = 65536;
+    }
+
+    if (port > 65535)
+    {
+      std::println(stderr, "s1ap_ingestd: bad UDP endpoint {}", endpoint);
+      return 1;
+    }
+
+    if (!ingest.AddUdpSocket(endpoint.substr(0, colon), static_cast<std::uint16_t>(port)).has_value())
+    {
+      std::println(stderr, "s1ap_ingestd: cannot bind UDP {}", endpoint);
+      return 1;
+    }
+  }
+
+  for (const auto& path : unixEndpoints)
+  {
+    if (!ingest.AddUnixSocket(path).has_value())
+    {
+      std::println(stderr, "s1ap_ingestd: cannot bind Unix socket {}", path);
+      return 1;
+    }
+  }
+
+  std::signal(SIGINT, OnSignal);
+  std::signal(SIGTERM, OnSignal);
+  std::signal(SIGUSR1, OnDumpSignal);
+
+  const std::size_t socketCount = udpEndpoints.size() + unixEndpoints.size();
+  auto lastReport = std::chrono::steady_clock::now();
+  std::uint64_t eventsSinceReport = 0;
+
+  while (!stop)
+  {
+    auto handled = ingest.RunOnce(100);
+    if (!handled.has_value())
+    {
+      std::println(stderr, "s1ap_ingestd: receive failed");
+      return 1;
+    }
+
+    eventsSinceReport += handled.value();
+
+    // SIGUSR1: history of the watched subscribers, from the ingest thread
+    // since S1apDB is not safe to read from the handler.
+    if (dumpTraces.exchange(false))
+    {
+      for (const auto imsi : trace.watchlist)
+      {
+        std::println(stderr, "s1ap_ingestd: trace of {}", imsi);
+
+        for (const auto& entry : S1apDB::GetInstance().GetTrace(imsi))
+          std::println(stderr, "  {} event {} state {} -> {}", entry.timestamp, static_cast<int>(entry.cause),
+                       static_cast<int>(entry.oldState), static_cast<int>(entry.newState));
+      }
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> elapsed = now - lastReport;
+
+    if (elapsed.count() < 1.0)
+      continue;
+
+    std::println(stderr, "s1ap_ingestd: {:.0f} events/s", eventsSinceReport / elapsed.count());
+
+    for (std::size_t i = 0; i < socketCount; ++i)
+    {
+      const auto& stats = ingest.GetStats(i);
+      std::println(stderr, "  socket {}: datagrams {} events {} rejected {} malformed {} truncated {} errors {} drops {}",
+                   i, stats.datagrams, stats.events, stats.rejectedRecords, stats.malformedFrames,
+                   stats.truncatedDatagrams, stats.handleErrors, stats.kernelDrops);
+    }
+
+    const auto& shed = S1apDB::GetInstance().GetAdmissionStats();
+    if (shed.overBudget != 0)
+      std::println(stderr, "  over budget {}: shed paging {} duplicate attach {}",
+                   shed.overBudget, shed.shedPaging, shed.shedDuplicateAttach);
+
+    lastReport = now;
+    eventsSinceReport = 0;
+  }
+
+  if (!exportPath.empty() && !WriteFile(exportPath, S1apDB::GetInstance().ExportSubscribers()))
+  {
+    std::println(stderr, "s1ap_ingestd: cannot write {}", exportPath);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,185 @@
+#include "S1apCodec.hpp"
+#include "Workload.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <print>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+  void PrintUsage()
+  {
+    std::println(stderr, "usage: s1ap_replay (--udp HOST:PORT | --unix PATH) [--events N] "
+                         "[--subscribers N] [--frame N] [--seed N]");
+  }
+}
+
+// Sends a seeded workload to s1ap_ingestd, one codec frame per datagram.
+int main(int argc, char** argv)
+{
+  WorkloadConfig workload{};
+  std::size_t eventsPerFrame = 512;
+  std::string udpEndpoint;
+  std::string unixPath;
+
+  // std::stoul and friends throw on garbage and on overflow.
+  try
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      const std::string_view arg = argv[i];
+
+      if (i + 1 >= argc)
+      {
+        PrintUsage();
+        return 1;
+      }
+
+      if (arg == "--udp")
+        udpEndpoint = argv[++i];
+      else if (arg == "--unix")
+        unixPath = argv[++i];
+      else if (arg == "--events")
+        workload.events = std::stoul(argv[++i]);
+      else if (arg == "--subscribers")
+        workload.subscribers = std::stoul(argv[++i]);
+      else if (arg == "--frame")
+        eventsPerFrame = std::stoul(argv[++i]);
+      else if (arg == "--seed")
+        workload.seed = std::stoull(argv[++i]);
+      else
+      {
+        PrintUsage();
+        return 1;
+      }
+    }
+  }
+  catch (const std::logic_error&)
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  if (workload.subscribers == 0 || eventsPerFrame == 0)
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  sockaddr_storage remote{};
+  socklen_t remoteSize = 0;
+  int fd = -1;
+
+  if (!udpEndpoint.empty())
+  {
+    auto& address = reinterpret_cast<sockaddr_in&>(remote);
+    const auto colon = udpEndpoint.rfind(':');
+    std::uint16_t port = 0;
+
+    if (colon == std::string::npos || ::inet_pton(AF_INET, udpEndpoint.substr(0, colon).c_str(), &address.sin_addr) != 1)
+    {
+      PrintUsage();
+      return 1;
+    }
+
+    const char* last = udpEndpoint.data() + udpEndpoint.size();
+    const auto [end, error] = std::from_chars(udpEndpoint.data() + colon + 1, last, port);
+
+    if (error != std::errc{} || end != last)
+    {
+      PrintUsage();
+      return 1;
+    }
+
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+
+    remoteSize = sizeof(sockaddr_in);
+    fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+  }
+  else if (!unixPath.empty())
+  {
+    auto& address = reinterpret_cast<sockaddr_un&>(remote);
+
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, unixPath.c_str(), sizeof(address.sun_path) - 1);
+
+    remoteSize = sizeof(sockaddr_un);
+    fd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+  }
+  else
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  if (fd < 0)
+  {
+    std::println(stderr, "s1ap_replay: cannot create socket");
+    return 1;
+  }
+
+  const auto events = GenerateWorkload(workload);
+  std::vector<std::vector<std::byte>> frames;
+
+  for (std::size_t offset = 0; offset < events.size(); offset += eventsPerFrame)
+  {
+    const auto count = std::min(eventsPerFrame, events.size() - offset);
+    auto& frame = frames.emplace_back();
+
+    if (!S1apCodec::Encode(std::span<const Event>(events.data() + offset, count), frame).has_value())
+    {
+      std::println(stderr, "s1ap_replay: cannot encode frame");
+      return 1;
+    }
+  }
+
+  constexpr std::size_t SEND_BATCH = 64;
+  std::vector<mmsghdr> messages(SEND_BATCH);
+  std::vector<iovec> iovecs(SEND_BATCH);
+
+  const auto start = std::chrono::steady_clock::now();
+
+  for (std::size_t first = 0; first < frames.size();)
+  {
+    const auto count = std::min(SEND_BATCH, frames.size() - first);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      iovecs[i] = iovec{.iov_base = frames[first + i].data(), .iov_len = frames[first + i].size()};
+      messages[i] = mmsghdr{};
+      messages[i].msg_hdr.msg_name = &remote;
+      messages[i].msg_hdr.msg_namelen = remoteSize;
+      messages[i].msg_hdr.msg_iov = &iovecs[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    const int sent = ::sendmmsg(fd, messages.data(), count, 0);
+    if (sent < 0)
+    {
+      std::println(stderr, "s1ap_replay: send failed: {}", std::strerror(errno));
+      return 1;
+    }
+
+    first += sent;
+  }
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::println("s1ap_replay: sent {} events in {} frames, {:.0f} events/s",
+               events.size(), frames.size(), events.size() / elapsed.count());
+
+  ::close(fd);
+  return 0;
+}